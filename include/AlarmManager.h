@@ -2,20 +2,33 @@
 #ifndef ALARM_MANAGER_H
 #define ALARM_MANAGER_H
 
+#include <stdint.h>
+
 /**
  * @brief Initializes the alarm module (configures buzzer pin)
  */
 void alarmManagerSetup();
 
 /**
- * @brief Updates alarm state and controls buzzer based on readings.
- * Should be called regularly in loop or after sensor reads.
+ * @brief Evaluates alarm conditions for a new sensor sample.
+ * Should be called once per measurement (SensorBus subscriber).
  * @param waterLevel Current water level reading (0-5)
  * @param batteryVoltage Current battery voltage (V)
  * @param soilMoisture Current soil moisture (%)
  * @return true if alarm state changed, false otherwise
  */
-bool alarmManagerUpdate(int waterLevel, float batteryVoltage, int soilMoisture);
+bool alarmManagerEvaluate(int waterLevel, float batteryVoltage, int soilMoisture);
+
+/**
+ * @brief Re-evaluates the last sample against current thresholds (after a config change)
+ * @return true if alarm state changed, false otherwise
+ */
+bool alarmManagerReevaluate();
+
+/**
+ * @brief Drives the buzzer beep sequence. Call when alarmManagerNextUpdateMs() expires.
+ */
+void alarmManagerUpdate();
 
 /**
  * @brief Returns current alarm state regardless of sound setting
@@ -23,4 +36,10 @@ bool alarmManagerUpdate(int waterLevel, float batteryVoltage, int soilMoisture);
  */
 bool alarmManagerIsAlarmActive();
 
+/**
+ * @brief Returns how many ms until the buzzer sequence needs the next update
+ * @return 0 = now, SCHEDULER_IDLE = buzzer idle (no deadline)
+ */
+uint32_t alarmManagerNextUpdateMs();
+
 #endif // ALARM_MANAGER_H
\ No newline at end of file
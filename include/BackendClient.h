@@ -0,0 +1,104 @@
+// BackendClient.h
+#ifndef BACKENDCLIENT_H
+#define BACKENDCLIENT_H
+
+#include <Arduino.h>
+#include <time.h>
+#include <WiFiClient.h>
+#include <HTTPClient.h>   // Tylko kody HTTP_CODE_* / HTTPC_ERROR_* - zapytania składamy sami
+
+/**
+ * Długo żyjąca sesja HTTP/1.1 (keep-alive) do backendu. Adres bazowy i token są wspólne,
+ * ale każde zadanie FreeRTOS używa własnej sesji (własne gniazdo) - np. zadanie sieciowe
+ * (telemetry + konfiguracja) i kanał komend (long-poll), który trzyma zapytanie do 30 s.
+ *
+ * Zapytanie i nagłówki odpowiedzi przechodzą przez stałe bufory - wymiana nie alokuje pamięci
+ * na stercie (poza buforami stosu TCP/IP).
+ */
+struct BackendSession {
+    const char* name = "";
+    WiFiClient  tcp;                     // Gniazdo TCP utrzymywane między zapytaniami
+    IPAddress   ip;
+    bool        ipValid = false;
+    uint8_t     consecutiveFailures = 0;
+    char        lastETag[24] = "";
+    uint32_t    pollHintMs = 0;          // Zalecany interwał odpytywania z ostatniej odpowiedzi (0 = brak)
+    time_t      serverTime = 0;          // Nagłówek Date ostatniej odpowiedzi (0 = brak)
+};
+
+/**
+ * Odbiorca treści odpowiedzi 2xx, czytanej prosto z gniazda (bez kopii do bufora).
+ * Nie musi czytać do końca - resztę treści klient odrzuca sam, żeby gniazdo nadawało się do reużycia.
+ */
+typedef void (*BackendBodyReader)(Stream& body, void* context);
+
+/**
+ * @brief Rozbiera adres bazowy backendu na host/port/ścieżkę i składa raz stałe nagłówki.
+ * @param baseUrl np. "http://192.168.1.10:8080" lub "http://flora.local:8080/prefix"
+ * @param token   Token Bearer
+ * @return false dla adresu innego niż http:// (np. https:// - klient nie obsługuje TLS) albo bez hosta/portu
+ */
+bool backendClientSetup(const char* baseUrl, const char* token);
+
+/**
+ * @brief Przygotowuje sesję (wywołać po backendClientSetup(), przed pierwszym zapytaniem).
+ * @param name Nazwa do logów
+ */
+void backendClientSessionInit(BackendSession& session, const char* name);
+
+/**
+ * @brief GET na ścieżkę względną do adresu bazowego (np. "/api/flora/x/config").
+ * @param etag   Ostatnio znany ETag (If-None-Match, np. "\"7\""); nullptr = zwykły GET.
+ *               Gdy zasób się nie zmienił, serwer zwraca 304 bez treści.
+ * @param reader Odbiorca treści 2xx; nullptr = treść jest pomijana
+ * @return Kod HTTP (>0) albo kod błędu HTTPC_ERROR_* (<0)
+ */
+int backendClientGet(BackendSession& session, const char* path, const char* etag,
+                     BackendBodyReader reader, void* context, uint16_t timeoutMs);
+
+/**
+ * @brief POST na ścieżkę względną do adresu bazowego.
+ * @param reader Odbiorca treści 2xx; nullptr = treść jest pomijana
+ * @return Kod HTTP (>0) albo kod błędu HTTPC_ERROR_* (<0)
+ */
+int backendClientPost(BackendSession& session, const char* path, const char* contentType,
+                      const uint8_t* body, size_t length, BackendBodyReader reader, void* context,
+                      uint16_t timeoutMs);
+
+/**
+ * @brief PUT na ścieżkę względną do adresu bazowego (zastępuje cały zasób, np. konfigurację).
+ * @param reader Odbiorca treści 2xx; nullptr = treść jest pomijana
+ * @return Kod HTTP (>0) albo kod błędu HTTPC_ERROR_* (<0)
+ */
+int backendClientPut(BackendSession& session, const char* path, const char* contentType,
+                     const uint8_t* body, size_t length, BackendBodyReader reader, void* context,
+                     uint16_t timeoutMs);
+
+/**
+ * @brief Nagłówek ETag z ostatniej odpowiedzi sesji (pusty, jeśli serwer go nie wysłał)
+ */
+const char* backendClientLastETag(const BackendSession& session);
+
+/**
+ * @brief Interwał odpytywania zalecany przez serwer w ostatniej odpowiedzi (nagłówek X-Flora-Poll-Ms)
+ * @return Czas w ms albo 0, jeśli serwer go nie podał
+ */
+uint32_t backendClientLastPollHintMs(const BackendSession& session);
+
+/**
+ * @brief Czas serwera z nagłówka Date ostatniej odpowiedzi (rozdzielczość 1 s)
+ * @return Czas Unix albo 0, jeśli serwer go nie podał
+ */
+time_t backendClientLastServerTime(const BackendSession& session);
+
+/**
+ * @brief Opis kodu błędu zwróconego przez backendClientGet/Post (stały napis, bez alokacji)
+ */
+const char* backendClientErrorToString(int code);
+
+/**
+ * @brief Zrywa połączenie sesji i zapomina adres IP (np. po utracie WiFi).
+ */
+void backendClientReset(BackendSession& session);
+
+#endif // BACKENDCLIENT_H
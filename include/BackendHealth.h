@@ -0,0 +1,66 @@
+// BackendHealth.h
+#ifndef BACKENDHEALTH_H
+#define BACKENDHEALTH_H
+
+#include <stdint.h>
+
+/**
+ * Stan zdrowia endpointów backendu: wykładniczy backoff po błędach i bezpiecznik (circuit breaker).
+ * Po BACKEND_HEALTH_TRIP_FAILURES kolejnych błędach obwód się otwiera - zapytania są pomijane
+ * (urządzenie działa na konfiguracji z Flash), a po upływie backoffu przepuszczane jest jedno
+ * zapytanie próbne (półotwarty). Sukces zamyka obwód, porażka otwiera go na dwa razy dłużej.
+ * Bezpieczne do wywołania z kilku zadań FreeRTOS.
+ */
+
+enum BackendEndpoint : uint8_t {
+    BACKEND_EP_SYNC = 0,    // /sync (i zapasowe /telemetry)
+    BACKEND_EP_CONFIG,      // GET /config
+    BACKEND_EP_COMMANDS,    // GET /commands (także long-poll)
+    BACKEND_EP_HISTORY,     // POST /telemetry/batch (historia z pamięci RTC)
+    BACKEND_EP_COUNT
+};
+
+enum BackendCircuitState : uint8_t {
+    BACKEND_CIRCUIT_CLOSED = 0,   // Normalna praca
+    BACKEND_CIRCUIT_OPEN,         // Zapytania wstrzymane do końca backoffu
+    BACKEND_CIRCUIT_HALF_OPEN     // Trwa jedno zapytanie próbne
+};
+
+/** Liczba kolejnych błędów, po której obwód się otwiera */
+constexpr uint8_t BACKEND_HEALTH_TRIP_FAILURES = 3;
+
+/**
+ * @brief Czy można teraz wysłać zapytanie do endpointu?
+ * W stanie otwartym po upływie backoffu przechodzi w półotwarty i przepuszcza jedno zapytanie -
+ * jego wynik trzeba zgłosić przez backendHealthReport().
+ */
+bool backendHealthAllow(BackendEndpoint ep);
+
+/**
+ * @brief Zgłasza wynik zapytania.
+ * @param success   false dla błędów transportu i odpowiedzi 5xx
+ * @param elapsedMs Czas trwania zapytania (przy błędzie doliczany do czasu blokady)
+ */
+void backendHealthReport(BackendEndpoint ep, bool success, uint32_t elapsedMs);
+
+/**
+ * @brief Za ile ms endpoint znów przyjmie zapytanie (0 = od razu)
+ */
+uint32_t backendHealthRetryInMs(BackendEndpoint ep);
+
+/**
+ * @brief Bieżący stan obwodu endpointu
+ */
+BackendCircuitState backendHealthState(BackendEndpoint ep);
+
+/**
+ * @brief Suma nieudanych zapytań (wszystkie endpointy) od startu
+ */
+uint32_t backendHealthTotalFailures();
+
+/**
+ * @brief Łączny czas spędzony w nieudanych zapytaniach (czekanie na timeout) od startu, w ms
+ */
+uint32_t backendHealthTotalBlockedMs();
+
+#endif // BACKENDHEALTH_H
@@ -2,15 +2,68 @@
 #define BACKEND_TASKS_H
 
 #include <Arduino.h>
+#include "SensorData.h"
+
+// Zdarzenia wysyłane poza kolejnością rutynowej telemetrii
+enum BackendEvent : uint8_t {
+    BACKEND_EVENT_NONE = 0,     // Rutynowy pomiar
+    BACKEND_EVENT_ALARM,        // Zmiana stanu alarmu
+    BACKEND_EVENT_PUMP_START,
+    BACKEND_EVENT_PUMP_STOP,
+};
 
 // Funkcja inicjalizująca (np. do pobrania początkowego ID komendy z Flash)
 void backendTasksSetup();
 
-// Pobiera ustawienia z serwera i nadpisuje lokalne
-void fetchAndApplyConfiguration();
+// Uruchamia zadanie sieciowe (FreeRTOS, rdzeń 0), które wykonuje całe I/O backendu.
+// Pętla sterująca wymienia z nim dane wyłącznie przez kolejki.
+void backendTasksStart();
+
+// Uruchamia kanał komend (long-poll na osobnym gnieździe) - komendy docierają w czasie jednej
+// odpowiedzi serwera zamiast co 2 s. Tylko dla trybu ciągłego; po wybudzeniu komendy przynosi /sync.
+void backendTasksStartCommandChannel();
+
+// Wrzuca snapshot do kolejki telemetry (nie blokuje; nowszy snapshot nadpisuje niewysłany).
+// Rutynowe pomiary idą leniwie - razem z najbliższym odpytaniem konfiguracji.
+void backendQueueTelemetry(const SensorData& data, bool pumpRunning, bool alarmActive);
+
+// Wrzuca zdarzenie do kolejki priorytetowej - zadanie sieciowe wysyła je od razu (z ponowieniami),
+// przed rutynową telemetrią. Zastępuje czekający rutynowy snapshot (ten sam pomiar, stary stan).
+void backendQueueEvent(BackendEvent event, const SensorData& data, bool pumpRunning, bool alarmActive);
+
+// Przenosi niewysłany snapshot z kolejki do historii w pamięci RTC (przed Deep Sleep) -
+// zadanie sieciowe wyśle go w paczce /telemetry/batch po najbliższym połączeniu
+void backendTasksStashPendingTelemetry();
+
+// Stosuje zmiany konfiguracji i wykonuje komendy (np. "podlej") odebrane przez zadanie sieciowe.
+// Wywoływane z loop() - nigdy nie blokuje na sieci.
+// Przekazujemy poziom wody jako argument, żeby ten plik nie musiał znać logiki czujników
+// @return true jeśli cokolwiek zostało zastosowane/wykonane
+bool backendTasksProcess(int currentWaterLevel);
+
+// Uruchamia pompę na komendę (z aplikacji przez backend albo z lokalnego API) - bez wody odmawia.
+// Wywoływane z loop().
+// @return false jeśli komenda została odrzucona (brak wody)
+bool backendTasksRunPump(uint32_t durationMs, int currentWaterLevel);
+
+// Stosuje konfigurację w formacie JSON backendu (te same pola, np. z lokalnego API) i wysyła
+// całą bieżącą konfigurację do backendu (PUT /config). Backend pozostaje źródłem prawdy:
+// wygrywa ostatnia zmiana, lokalna albo z aplikacji.
+// Wywoływane z loop().
+// @return false jeśli JSON jest błędny albo nie zawiera żadnego znanego pola
+bool backendTasksApplyConfigJson(const char* json, size_t length);
+
+// Czy zadanie sieciowe zostawiło w kolejkach coś do przetworzenia przez loop()?
+bool backendTasksHasPending();
+
+// Okno nasłuchu (wybudzenie tylko po komendy): włączone przed backendTasksStart() sprawia, że
+// backendTasksWaitForSync() pobiera wyłącznie komendy - bez telemetrii, historii i konfiguracji.
+// Wyłączenie przywraca zwykłe cykle (np. gdy przyszła komenda i urządzenie robi pełny pomiar).
+void backendTasksSetListenWindow(bool enabled);
 
-// Pobiera i wykonuje komendy (np. "podlej")
-// Przekazujemy poziom wody jako argument, żeby ten plik nie musiał znać struktury czujników
-void fetchAndExecuteCommands(int currentWaterLevel);
+// Wymusza pełny cykl synchronizacji (telemetry + konfiguracja + komendy) i czeka na jego koniec.
+// Używane w setup() przed decyzją o Deep Sleep.
+// @return true jeśli cykl zakończył się przed upływem timeoutMs
+bool backendTasksWaitForSync(uint32_t timeoutMs);
 
-#endif
\ No newline at end of file
+#endif
@@ -1,6 +1,8 @@
 #ifndef BUTTONMANAGER_H
 #define BUTTONMANAGER_H
 
+#include <stdint.h>
+
 /**
  * @brief Inicjalizuje moduł przycisku.
  * Konfiguruje pin GPIO przycisku jako wejście z podciąganiem (pull-up).
@@ -19,4 +21,12 @@ void buttonSetup();
  */
 bool buttonWasPressed(); // Zmieniona nazwa funkcji dla jasności
 
+/**
+ * @brief Zwraca za ile ms buttonWasPressed() ma coś do zrobienia (debouncing w toku).
+ * Zbocze na pinie budzi pętlę główną przerwaniem, więc w spoczynku nie ma terminu.
+ *
+ * @return 0 = teraz, SCHEDULER_IDLE = przycisk w stanie stabilnym.
+ */
+uint32_t buttonNextUpdateMs();
+
 #endif // BUTTONMANAGER_H
\ No newline at end of file
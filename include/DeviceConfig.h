@@ -152,4 +152,8 @@ bool configSetMeasurementTime(int hour, int minute);
 int configGetLastCommandId();
 void configSetLastCommandId(int id);
 
+/** Version (ETag) of the last backend config applied on the device (0 = none) */
+uint32_t configGetBackendConfigVersion();
+void configSetBackendConfigVersion(uint32_t version);
+
 #endif // DEVICECONFIG_H
@@ -17,4 +17,26 @@ void environmentSensorSetup();
  */
 bool environmentSensorRead(float &temperature, float &humidity);
 
+/**
+ * @brief Starts a non-blocking read: powers the sensor and starts the stabilization window.
+ */
+void environmentSensorBeginRead();
+
+/**
+ * @brief Reads the sensor once its stabilization window has expired.
+ * @return true when the result is ready (environmentSensorResult()).
+ */
+bool environmentSensorPoll();
+
+/**
+ * @brief Milliseconds until environmentSensorPoll() should be called again (0 = now).
+ */
+uint32_t environmentSensorNextPollMs();
+
+/**
+ * @brief Result of the last completed read.
+ * @return true if reading was successful, false in case of error.
+ */
+bool environmentSensorResult(float &temperature, float &humidity);
+
 #endif // ENVIRONMENTSENSOR_H
\ No newline at end of file
@@ -31,6 +31,12 @@ void ledManagerSetState(LedState state);
  */
 void ledManagerUpdate();
 
+/**
+ * @brief Zwraca za ile ms ledManagerUpdate() ma coś do zrobienia.
+ * @return 0 = teraz, SCHEDULER_IDLE = stan stały (ON/OFF), brak terminu.
+ */
+uint32_t ledManagerNextUpdateMs();
+
 // --- Opcjonalne funkcje pomocnicze ---
 /**
  * @brief Włącza diodę na stałe (skrót do ledManagerSetState(LED_ON)).
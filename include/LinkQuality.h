@@ -0,0 +1,48 @@
+// LinkQuality.h
+#ifndef LINKQUALITY_H
+#define LINKQUALITY_H
+
+#include <stdint.h>
+
+/**
+ * Jakość łącza do backendu: RSSI WiFi oraz średnie kroczące czasu odpowiedzi i odsetka błędów
+ * zapytań. Przy słabym łączu rutynowa wysyłka jest odkładana (najwyżej
+ * LINK_MAX_CONSECUTIVE_DEFERRALS razy z rzędu) zamiast palić baterię na ponowieniach i timeoutach.
+ * Statystyki leżą w pamięci RTC, więc obejmują kolejne wybudzenia z Deep Sleep.
+ */
+
+/** Tyle razy z rzędu można odłożyć wysyłkę - potem idzie mimo słabego łącza */
+constexpr uint8_t LINK_MAX_CONSECUTIVE_DEFERRALS = 3;
+
+/** Metryki łącza (eksportowane w snapshocie, do korelacji zużycia energii z miejscem donicy) */
+struct LinkMetrics {
+    int8_t   rssi;            // dBm, 0 = jeszcze brak odczytu
+    uint16_t rttMs;           // Średni czas udanego zapytania (EWMA)
+    uint8_t  failurePercent;  // Odsetek nieudanych zapytań (EWMA)
+    uint16_t deferrals;       // Łączna liczba odłożonych wysyłek od zimnego startu
+};
+
+/**
+ * @brief Zgłasza wynik zapytania do backendu (krótkiego - bez long-polla, który wisi celowo)
+ * @param success   false dla błędów transportu i odpowiedzi 5xx
+ * @param elapsedMs Czas zapytania (wlicza się do średniej tylko przy sukcesie)
+ */
+void linkQualityReport(bool success, uint32_t elapsedMs);
+
+/**
+ * @brief Czy odłożyć rutynową wysyłkę? Odczytuje RSSI; wywoływać tylko przy połączonym WiFi.
+ * @return true = łącze słabe i limit odłożeń nie wyczerpany (odłożenie jest liczone)
+ */
+bool linkQualityShouldDefer();
+
+/**
+ * @brief Ile wysyłek z rzędu jest odłożonych (0 = ostatnia próba poszła)
+ */
+uint8_t linkQualityPendingDeferrals();
+
+/**
+ * @brief Bieżące metryki łącza
+ */
+LinkMetrics linkQualityMetrics();
+
+#endif // LINKQUALITY_H
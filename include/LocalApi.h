@@ -0,0 +1,37 @@
+// LocalApi.h
+#ifndef LOCALAPI_H
+#define LOCALAPI_H
+
+#include <stdint.h>
+
+/**
+ * Lokalne API HTTP w sieci LAN (tylko tryb ciągły): aplikacja w tej samej sieci czyta stan
+ * i steruje donicą bezpośrednio, bez pośrednictwa backendu. Każde zapytanie wymaga nagłówka
+ * "Authorization: Bearer <token>" (FLORA_LOCAL_API_TOKEN - osobny, inny niż token backendu;
+ * bez niego API pozostaje wyłączone).
+ *
+ *   GET  /api/status  - ostatni pomiar z SensorBus oraz stan pompy i alarmu
+ *   POST /api/pump    - {"durationMs": 500..30000}; bez wody 409 (jak komendy z backendu)
+ *   POST /api/config  - pola jak w konfiguracji backendu (np. {"soilThresholdPercent": 35})
+ */
+
+/** Wywoływane po zastosowaniu konfiguracji z lokalnego API (progi alarmów mogły się zmienić) */
+typedef void (*LocalApiConfigHandler)();
+
+/**
+ * @brief Rejestruje odbiorcę zmian konfiguracji. Serwer startuje sam, gdy urządzenie
+ * jest w trybie ciągłym i ma połączenie WiFi, a zatrzymuje się, gdy któregoś z nich zabraknie.
+ */
+void localApiSetup(LocalApiConfigHandler onConfigApplied);
+
+/**
+ * @brief Obsługa zapytań (wywoływać z zadania schedulera, gdy localApiNextMs() zwróci 0)
+ */
+void localApiProcess();
+
+/**
+ * @brief Za ile ms API potrzebuje obsługi (SCHEDULER_IDLE = wyłączone / poza trybem ciągłym)
+ */
+uint32_t localApiNextMs();
+
+#endif // LOCALAPI_H
@@ -0,0 +1,41 @@
+// MeasurementPipeline.h
+#ifndef MEASUREMENTPIPELINE_H
+#define MEASUREMENTPIPELINE_H
+
+#include <stdint.h>
+#include "SensorData.h"
+
+/** Wywoływane raz, gdy wszystkie kanały pomiarowe są gotowe */
+typedef void (*MeasurementDoneFn)(const SensorData& data);
+
+/**
+ * @brief Rozpoczyna pomiar: odczytuje baterię i włącza jednocześnie DHT, VCC gleby
+ * oraz pierwszą sondę wody. Każdy kanał jest próbkowany, gdy minie jego czas stabilizacji.
+ * @param onDone Callback wywoływany po zakończeniu wszystkich kanałów (może być nullptr)
+ * @return false jeśli pomiar jest już w toku
+ */
+bool measurementPipelineStart(MeasurementDoneFn onDone);
+
+/**
+ * @brief Wykonuje kroki kanałów, których termin minął. Wywoływać gdy
+ * measurementPipelineNextUpdateMs() zwróci 0 (zadanie schedulera).
+ */
+void measurementPipelineUpdate();
+
+/**
+ * @brief Za ile ms pipeline potrzebuje kolejnego measurementPipelineUpdate()
+ * @return 0 = teraz, SCHEDULER_IDLE = brak pomiaru w toku
+ */
+uint32_t measurementPipelineNextUpdateMs();
+
+/**
+ * @brief Czy pomiar jest w toku?
+ */
+bool measurementPipelineIsRunning();
+
+/**
+ * @brief Blokuje do zakończenia bieżącego pomiaru (używane w setup(), przed startem schedulera)
+ */
+void measurementPipelineAwait();
+
+#endif // MEASUREMENTPIPELINE_H
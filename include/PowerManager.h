@@ -3,18 +3,59 @@
 #define POWERMANAGER_H
 
 #include <stdint.h>
+#include <time.h>
+
+/** Rodzaj wybudzenia timerem zaplanowany przed snem (pamięć RTC) */
+enum PowerWakeKind : uint8_t {
+    POWER_WAKE_SCHEDULED = 0,  // Zaplanowany pomiar z synchronizacją (także reset, przycisk)
+    POWER_WAKE_SENSING,        // Tylko pomiar, bez WiFi
+    POWER_WAKE_LISTEN,         // Tylko WiFi i sprawdzenie komend, bez czujników
+};
+
+/**
+ * @brief Przechodzi w tryb głębokiego snu do najbliższego z wybudzeń: zaplanowanego pomiaru,
+ * pomiarowego albo nasłuchu. Rodzaj wybudzenia zapamiętuje w pamięci RTC.
+ * @param sensingIntervalSec Odstęp wybudzeń pomiarowych (bez WiFi); 0 = wyłączone.
+ *        Odliczanie biegnie także przez wybudzenia nasłuchu.
+ * @param listenIntervalSec  Odstęp wybudzeń nasłuchu komend; 0 = wyłączone.
+ */
+void powerManagerGoToDeepSleep(uint32_t sensingIntervalSec, uint32_t listenIntervalSec);
+
+/**
+ * @brief Rodzaj bieżącego wybudzenia (POWER_WAKE_SCHEDULED, jeśli nie obudził nas timer)
+ */
+PowerWakeKind powerManagerWakeKind();
+
+/**
+ * @brief Ustawia strefę czasową i koryguje zegar o zmierzony dryft RTC za czas snu.
+ * Wywoływać na początku setup(), zanim cokolwiek odczyta czas.
+ */
+void powerManagerInitClock();
+
+/**
+ * @brief Czy przy tym połączeniu zsynchronizować czas z NTP? Tak, gdy zegar nie jest ustawiony,
+ * minęło kilkanaście wybudzeń od ostatniego NTP albo serwer wykazał dużą rozbieżność.
+ */
+bool powerManagerTimeSyncDue();
 
 /**
- * @brief Przechodzi w tryb głębokiego snu na czas określony w konfiguracji
+ * @brief Czas z nagłówka Date odpowiedzi backendu - koryguje zegar, gdy różnica przekracza
+ * rozdzielczość nagłówka. Bezpieczne do wywołania z zadania sieciowego.
+ * @param serverTime Czas Unix (0 = brak nagłówka, ignorowane)
  */
-void powerManagerGoToDeepSleep();
+void powerManagerApplyServerTime(time_t serverTime);
 
 /**
- * @brief Synchronizuje czas z serwerem NTP
+ * @brief Synchronizuje czas z serwerem NTP (blokuje do 10 s)
  * @return true jeśli synchronizacja się powiodła, false w przeciwnym razie
  */
 bool powerManagerSyncTime();
 
+/**
+ * @brief Uruchamia synchronizację NTP w tle (nie czeka na wynik; wynik mierzy też dryft RTC)
+ */
+void powerManagerBeginTimeSync();
+
 /**
  * @brief Oblicza czas do następnego zaplanowanego pomiaru
  * @return Czas w mikrosekundach do następnego pomiaru
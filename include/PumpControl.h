@@ -38,4 +38,10 @@ bool pumpControlIsRunning();
  */
 void pumpControlUpdate();
 
+/**
+ * @brief Returns how many ms until pumpControlUpdate() has work to do
+ * @return 0 = now, SCHEDULER_IDLE = pump is off (no deadline)
+ */
+uint32_t pumpControlNextUpdateMs();
+
 #endif // PUMP_CONTROL_H
\ No newline at end of file
@@ -0,0 +1,56 @@
+// Scheduler.h
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+/** Zadanie nie ma najbliższego terminu - czeka wyłącznie na zdarzenie (schedulerTrigger) */
+constexpr uint32_t SCHEDULER_IDLE = UINT32_MAX;
+
+/** Wykonuje pracę zadania (wywoływane tylko gdy zadanie jest "na czasie" lub wyzwolone) */
+typedef void (*SchedulerRunFn)();
+
+/**
+ * Zwraca za ile ms zadanie chce zostać wywołane (0 = teraz, SCHEDULER_IDLE = brak terminu).
+ * Funkcja musi być tania i bez efektów ubocznych - scheduler odpytuje ją po każdym przebiegu.
+ */
+typedef uint32_t (*SchedulerNextFn)();
+
+/**
+ * @brief Inicjalizuje scheduler. Wywołać z zadania, które później woła schedulerRun() (loop()).
+ */
+void schedulerSetup();
+
+/**
+ * @brief Rejestruje zadanie.
+ * @return Identyfikator zadania (0..N-1) lub -1 gdy tablica zadań jest pełna
+ */
+int schedulerAdd(const char* name, SchedulerRunFn run, SchedulerNextFn next);
+
+/**
+ * @brief Wymusza wykonanie zadania w najbliższym przebiegu (bezpieczne z innych zadań FreeRTOS).
+ */
+void schedulerTrigger(int taskId);
+
+/**
+ * @brief Budzi pętlę główną bez wskazywania zadania (np. nowe dane w kolejce).
+ */
+void schedulerNotify();
+
+/**
+ * @brief Wersja schedulerNotify() do wywołania z przerwania (ISR).
+ */
+void schedulerNotifyFromISR();
+
+/**
+ * @brief Jeden przebieg: wykonuje zadania, których termin minął, i blokuje do najbliższego
+ * terminu albo do zdarzenia. Wywoływać w loop().
+ */
+void schedulerRun();
+
+/**
+ * @brief Liczba wybudzeń pętli głównej od startu (diagnostyka)
+ */
+uint32_t schedulerGetWakeCount();
+
+#endif // SCHEDULER_H
@@ -0,0 +1,37 @@
+// SensorBus.h
+#ifndef SENSORBUS_H
+#define SENSORBUS_H
+
+#include <stdint.h>
+#include "SensorData.h"
+
+/**
+ * Odbiorca nowych pomiarów.
+ * @param data    Świeży pomiar
+ * @param version Numer kolejny pomiaru (rośnie z każdą publikacją, 0 = brak pomiaru)
+ */
+typedef void (*SensorBusHandler)(const SensorData& data, uint32_t version);
+
+/**
+ * @brief Rejestruje odbiorcę. Odbiorcy są wywoływani w kolejności rejestracji.
+ * @return true jeśli udało się zarejestrować
+ */
+bool sensorBusSubscribe(const char* name, SensorBusHandler handler);
+
+/**
+ * @brief Publikuje nowy pomiar - zapisuje go jako najnowszy i wywołuje wszystkich odbiorców.
+ * @return Numer wersji nadany pomiarowi
+ */
+uint32_t sensorBusPublish(const SensorData& data);
+
+/**
+ * @brief Ostatnio opublikowany pomiar (wartości domyślne, jeśli jeszcze nie było pomiaru)
+ */
+const SensorData& sensorBusLatest();
+
+/**
+ * @brief Wersja ostatnio opublikowanego pomiaru (0 = brak)
+ */
+uint32_t sensorBusVersion();
+
+#endif // SENSORBUS_H
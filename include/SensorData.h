@@ -0,0 +1,27 @@
+#ifndef SENSORDATA_H
+#define SENSORDATA_H
+
+#include <math.h>
+
+/**
+ * @struct SensorData
+ * @brief Structure storing data from all sensors
+ */
+struct SensorData {
+    int soilMoisture = -1;
+    int waterLevel = -1;
+    float batteryVoltage = -1.0f;
+    float temperature = NAN;
+    float humidity = NAN;
+    bool dhtOk = false;
+
+    /**
+     * @brief Checks if data is valid
+     * @return true if basic data is available
+     */
+    bool isValid() const {
+        return soilMoisture >= 0 && waterLevel >= 0 && batteryVoltage > 0;
+    }
+};
+
+#endif // SENSORDATA_H
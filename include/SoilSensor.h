@@ -1,11 +1,27 @@
 #ifndef SOILSENSOR_H
 #define SOILSENSOR_H
 
+#include <stdint.h>
+
 // Funkcja inicjalizująca (np. konfigurująca pin VCC)
 void soilSensorSetup();
 
 // Funkcja odczytująca wilgotność
 // Zwraca wartość w procentach (0-100)
+// (blokuje ~750 ms - wersja nieblokująca poniżej)
 int soilSensorReadPercent();
 
+// Odczyt nieblokujący: włącza VCC i zaczyna odliczać czas stabilizacji
+void soilSensorBeginRead();
+
+// Wykonuje kolejny krok odczytu, jeśli nadszedł jego czas
+// Zwraca true, gdy wynik jest gotowy (soilSensorResult())
+bool soilSensorPoll();
+
+// Za ile ms warto ponownie wywołać soilSensorPoll() (0 = od razu)
+uint32_t soilSensorNextPollMs();
+
+// Wynik ostatniego zakończonego odczytu w procentach (0-100, -1 = błąd)
+int soilSensorResult();
+
 #endif // SOILSENSOR_H
\ No newline at end of file
@@ -0,0 +1,53 @@
+// TelemetryHistory.h
+#ifndef TELEMETRYHISTORY_H
+#define TELEMETRYHISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Bufor pierścieniowy pomiarów, których nie udało się wysłać (brak WiFi, błąd serwera, sen przed
+ * synchronizacją). Leży w pamięci RTC (RTC_DATA_ATTR), więc przetrwa Deep Sleep - po połączeniu
+ * zadanie sieciowe wysyła całą historię jednym zapytaniem. Po zapełnieniu najstarszy rekord
+ * jest nadpisywany. Bezpieczne do wywołania z loop() i z zadania sieciowego.
+ */
+
+/** Liczba rekordów w pamięci RTC (20 B każdy) */
+constexpr size_t TELEMETRY_HISTORY_CAPACITY = 48;
+
+/** Zwarty pomiar - te same jednostki stałoprzecinkowe co binarny snapshot */
+struct TelemetryRecord {
+    uint32_t seq;                  // Nadawany przez telemetryHistoryPush() (rośnie, także przez Deep Sleep)
+    uint32_t measuredAt;           // Czas Unix pomiaru (s), 0 = zegar nie był jeszcze ustawiony
+    uint16_t batteryMilliVolts;    // 0 = błąd odczytu
+    int16_t  temperatureCentiC;    // 0.01 °C
+    uint16_t humidityCentiPercent; // 0.01 %
+    int8_t   soilMoisturePercent;  // -1 = błąd odczytu
+    int8_t   waterLevel;           // -1 = błąd odczytu
+    uint8_t  flags;                // Bity jak we fladze binarnego snapshotu (pompa, alarm, DHT ok)
+};
+
+/**
+ * @brief Dopisuje rekord (pole seq jest nadpisywane); przy pełnym buforze wypiera najstarszy
+ * @return Numer nadany rekordowi
+ */
+uint32_t telemetryHistoryPush(const TelemetryRecord& record);
+
+/**
+ * @brief Kopiuje najstarsze rekordy (bez usuwania)
+ * @return Liczba skopiowanych rekordów
+ */
+size_t telemetryHistoryPeek(TelemetryRecord* out, size_t maxRecords);
+
+/**
+ * @brief Usuwa rekordy potwierdzone przez serwer (seq <= lastSeq).
+ * Rekordy dopisane w trakcie wysyłki zostają.
+ */
+void telemetryHistoryAck(uint32_t lastSeq);
+
+/**
+ * @brief Liczba rekordów czekających na wysyłkę
+ */
+size_t telemetryHistoryCount();
+
+#endif // TELEMETRYHISTORY_H
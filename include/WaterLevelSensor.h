@@ -18,4 +18,25 @@ void waterLevelSensorSetup();
  */
 int waterLevelSensorReadLevel();
 
+/**
+ * @brief Rozpoczyna odczyt nieblokujący (zasila najwyższą sondę).
+ */
+void waterLevelSensorBeginRead();
+
+/**
+ * @brief Odczytuje sondę, której czas stabilizacji minął, i zasila kolejną.
+ * @return true gdy wynik jest gotowy (waterLevelSensorResult())
+ */
+bool waterLevelSensorPoll();
+
+/**
+ * @brief Za ile ms warto ponownie wywołać waterLevelSensorPoll() (0 = od razu).
+ */
+uint32_t waterLevelSensorNextPollMs();
+
+/**
+ * @brief Wynik ostatniego zakończonego odczytu (0-5).
+ */
+int waterLevelSensorResult();
+
 #endif // WATERLEVELSENSOR_H
\ No newline at end of file
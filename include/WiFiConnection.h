@@ -0,0 +1,55 @@
+// WiFiConnection.h
+#ifndef WIFICONNECTION_H
+#define WIFICONNECTION_H
+
+#include <stdint.h>
+
+/**
+ * @brief Rozpoczyna asocjację STA z zapisanymi danymi sieci (nie blokuje).
+ * Wywoływać zaraz po configSetup(), żeby łączenie trwało równolegle z pomiarem.
+ * Po Deep Sleep łączy się od razu z ostatnim AP i kanałem (pamięć RTC), a gdy dzierżawa DHCP
+ * jest świeża - także bez DHCP. Nieudana szybka próba przechodzi w pełne łączenie ze skanem.
+ * @return false jeśli w pamięci nie ma zapisanej sieci (wtedy tylko portal WiFiManager)
+ */
+bool wifiConnectionBegin();
+
+/**
+ * @brief Czy w pamięci WiFi jest zapisana sieć?
+ */
+bool wifiConnectionHasCredentials();
+
+/**
+ * @brief Czeka (maks. timeoutMs liczone od wifiConnectionBegin()) na uzyskanie adresu IP.
+ * Tu następuje przejście z szybkiego łączenia na pełne, jeśli szybkie nie zdążyło.
+ * @return true jeśli połączono
+ */
+bool wifiConnectionAwait(uint32_t timeoutMs);
+
+/**
+ * @brief Czy STA ma połączenie i adres IP?
+ */
+bool wifiConnectionIsConnected();
+
+/**
+ * @brief Otwiera portal konfiguracyjny WiFiManager w trybie nieblokującym.
+ * Portal obsługuje wifiConnectionPortalProcess() wywoływane z zadania schedulera.
+ * @param timeoutSec Po tylu sekundach bez konfiguracji portal zamyka się sam
+ */
+void wifiConnectionStartPortal(uint16_t timeoutSec);
+
+/**
+ * @brief Obsługa portalu (DNS + serwer WWW). Wywoływać gdy wifiConnectionPortalNextMs() zwróci 0.
+ */
+void wifiConnectionPortalProcess();
+
+/**
+ * @brief Za ile ms portal potrzebuje obsługi (SCHEDULER_IDLE = portal zamknięty)
+ */
+uint32_t wifiConnectionPortalNextMs();
+
+/**
+ * @brief Czy portal konfiguracyjny jest otwarty?
+ */
+bool wifiConnectionPortalActive();
+
+#endif // WIFICONNECTION_H
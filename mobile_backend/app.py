@@ -1,18 +1,46 @@
 from __future__ import annotations
 
+import asyncio
 import json
 import os
 import sqlite3
+import struct
+import time
 from contextlib import contextmanager
 from datetime import datetime, timezone
 from typing import Any
 
-from fastapi import Depends, FastAPI, Header, HTTPException, status
-from pydantic import BaseModel, Field
+from fastapi import Depends, FastAPI, Header, HTTPException, Request, Response, status
+from pydantic import BaseModel, Field, ValidationError
 
 APP_TITLE = "Flora Mobile Backend"
 DB_PATH = os.getenv("FLORA_DB_PATH", "./flora_backend.db")
 API_TOKEN = os.getenv("TOKEN_SUPLA", "change-me-token")
+MAX_COMMAND_WAIT_S = 30
+ACTIVE_POLL_MS = 2000
+IDLE_POLL_MS = 300000
+VIEWER_ACTIVE_S = 120
+POLL_HEADER = "X-Flora-Poll-Ms"
+BINARY_TELEMETRY_TYPE = "application/x-flora-telemetry"
+BINARY_SNAPSHOT_V1 = struct.Struct("<BBbbHhHHI")
+# v2: version, flags, field mask, then only the fields present in the mask (bit order)
+BINARY_SNAPSHOT_V2_HEADER = struct.Struct("<BBB")
+BINARY_SNAPSHOT_V2_FIELDS = (
+    (0x01, struct.Struct("<b"), lambda v: {"soilMoisturePercent": v[0]}),
+    (0x02, struct.Struct("<b"), lambda v: {"waterLevel": v[0]}),
+    (0x04, struct.Struct("<H"), lambda v: {"batteryVoltage": v[0] / 1000}),
+    (0x08, struct.Struct("<h"), lambda v: {"temperature": v[0] / 100}),
+    (0x10, struct.Struct("<H"), lambda v: {"humidity": v[0] / 100}),
+    (0x20, struct.Struct("<HI"), lambda v: {"backendFailures": v[0], "backendBlockedMs": v[1]}),
+    (0x40, struct.Struct("<bHH"), lambda v: {"wifiRssi": v[0], "linkRttMs": v[1], "uploadDeferrals": v[2]}),
+)
+# /telemetry/batch: version, count, then count x (measuredAt, flags, soil, water, battery mV, temp, humidity)
+BINARY_HISTORY_V1_HEADER = struct.Struct("<BB")
+BINARY_HISTORY_V1_RECORD = struct.Struct("<IBbbHhH")
+MAX_HISTORY_BATCH = 255
+
+command_events: dict[str, asyncio.Event] = {}
+last_viewed: dict[str, float] = {}
 
 
 class PlantSnapshot(BaseModel):
@@ -23,6 +51,11 @@ class PlantSnapshot(BaseModel):
     humidity: float = 0.0
     pumpRunning: bool = False
     alarmActive: bool = False
+    backendFailures: int = 0
+    backendBlockedMs: int = 0
+    wifiRssi: int = 0  # dBm, 0 = not measured yet
+    linkRttMs: int = 0
+    uploadDeferrals: int = 0
     updatedAt: str = Field(default_factory=lambda: now_iso())
 
 
@@ -62,6 +95,32 @@ class CommandsResponse(BaseModel):
     items: list[CommandItem]
 
 
+class HistoryRecord(BaseModel):
+    measuredAt: int = Field(0, ge=0, le=2**32 - 1)  # Unix seconds on the device clock, 0 = clock was not set
+    snapshot: PlantSnapshot
+
+
+class TelemetryBatch(BaseModel):
+    records: list[HistoryRecord] = Field(max_length=MAX_HISTORY_BATCH)
+
+
+class HistoryItem(BaseModel):
+    measuredAt: str
+    receivedAt: str
+    snapshot: PlantSnapshot
+
+
+class HistoryResponse(BaseModel):
+    items: list[HistoryItem]
+
+
+class SyncResponse(BaseModel):
+    stored: bool
+    configVersion: int
+    config: PlantConfig | None  # None = device already has configVersion
+    commands: list[CommandItem]
+
+
 def now_iso() -> str:
     return datetime.now(timezone.utc).isoformat()
 
@@ -85,10 +144,14 @@ def init_db() -> None:
               device_id TEXT PRIMARY KEY,
               snapshot_json TEXT NOT NULL,
               config_json TEXT NOT NULL,
+              config_version INTEGER NOT NULL DEFAULT 1,
               updated_at TEXT NOT NULL
             )
             """
         )
+        columns = {row["name"] for row in conn.execute("PRAGMA table_info(devices)")}
+        if "config_version" not in columns:
+            conn.execute("ALTER TABLE devices ADD COLUMN config_version INTEGER NOT NULL DEFAULT 1")
         conn.execute(
             """
             CREATE TABLE IF NOT EXISTS commands (
@@ -100,6 +163,20 @@ def init_db() -> None:
             )
             """
         )
+        conn.execute(
+            """
+            CREATE TABLE IF NOT EXISTS telemetry_history (
+              id INTEGER PRIMARY KEY AUTOINCREMENT,
+              device_id TEXT NOT NULL,
+              measured_at TEXT NOT NULL,
+              received_at TEXT NOT NULL,
+              snapshot_json TEXT NOT NULL
+            )
+            """
+        )
+        conn.execute(
+            "CREATE INDEX IF NOT EXISTS idx_history_device_time ON telemetry_history(device_id, measured_at)"
+        )
 
 
 app = FastAPI(title=APP_TITLE)
@@ -140,37 +217,88 @@ def get_or_create_device(device_id: str) -> tuple[PlantSnapshot, PlantConfig]:
         return snapshot, config
 
 
+def load_config_version(device_id: str) -> int:
+    with db_conn() as conn:
+        row = conn.execute(
+            "SELECT config_version FROM devices WHERE device_id = ?",
+            (device_id,),
+        ).fetchone()
+    return int(row["config_version"]) if row else 1
+
+
+def config_etag(version: int) -> str:
+    return f'"{version}"'
+
+
+def viewer_active(device_id: str) -> bool:
+    return time.monotonic() - last_viewed.get(device_id, float("-inf")) < VIEWER_ACTIVE_S
+
+
+def mark_viewed(device_id: str) -> None:
+    was_active = viewer_active(device_id)
+    last_viewed[device_id] = time.monotonic()
+    if not was_active:
+        notify_commands(device_id)
+
+
+def poll_interval_ms(device_id: str) -> str:
+    return str(ACTIVE_POLL_MS if viewer_active(device_id) else IDLE_POLL_MS)
+
+
 @app.get("/health")
 def health() -> dict[str, str]:
     return {"status": "ok", "time": now_iso()}
 
 
 @app.get("/api/flora/{device_id}/snapshot", response_model=PlantSnapshot, dependencies=[Depends(require_auth)])
-def get_snapshot(device_id: str) -> PlantSnapshot:
+async def get_snapshot(device_id: str) -> PlantSnapshot:
     snapshot, _ = get_or_create_device(device_id)
+    mark_viewed(device_id)
     return snapshot
 
 
 @app.get("/api/flora/{device_id}/config", response_model=PlantConfig, dependencies=[Depends(require_auth)])
-def get_config(device_id: str) -> PlantConfig:
+def get_config(
+    device_id: str,
+    response: Response,
+    if_none_match: str | None = Header(default=None),
+) -> PlantConfig | Response:
     _, config = get_or_create_device(device_id)
+    etag = config_etag(load_config_version(device_id))
+    if if_none_match is not None and etag in [tag.strip().removeprefix("W/") for tag in if_none_match.split(",")]:
+        return Response(
+            status_code=status.HTTP_304_NOT_MODIFIED,
+            headers={"ETag": etag, POLL_HEADER: poll_interval_ms(device_id)},
+        )
+
+    response.headers["ETag"] = etag
+    response.headers[POLL_HEADER] = poll_interval_ms(device_id)
     return config
 
 
 @app.put("/api/flora/{device_id}/config", response_model=PlantConfig, dependencies=[Depends(require_auth)])
-def put_config(device_id: str, payload: PlantConfig) -> PlantConfig:
-    get_or_create_device(device_id)
+async def put_config(device_id: str, payload: PlantConfig, response: Response, source: str = "app") -> PlantConfig:
+    _, current = get_or_create_device(device_id)
+    # The firmware forwards LAN API changes with source=device - nobody is looking at the app then
+    if source != "device":
+        mark_viewed(device_id)
     with db_conn() as conn:
         conn.execute(
-            "UPDATE devices SET config_json = ?, updated_at = ? WHERE device_id = ?",
-            (payload.model_dump_json(), now_iso(), device_id),
+            """
+            UPDATE devices
+            SET config_json = ?, config_version = config_version + ?, updated_at = ?
+            WHERE device_id = ?
+            """,
+            (payload.model_dump_json(), int(payload != current), now_iso(), device_id),
         )
+    response.headers["ETag"] = config_etag(load_config_version(device_id))
     return payload
 
 
 @app.post("/api/flora/{device_id}/actions/pump", status_code=status.HTTP_202_ACCEPTED, dependencies=[Depends(require_auth)])
-def post_pump(device_id: str, payload: PumpAction) -> dict[str, Any]:
+async def post_pump(device_id: str, payload: PumpAction) -> dict[str, Any]:
     get_or_create_device(device_id)
+    mark_viewed(device_id)
     created_at = now_iso()
     with db_conn() as conn:
         cur = conn.execute(
@@ -179,33 +307,155 @@ def post_pump(device_id: str, payload: PumpAction) -> dict[str, Any]:
         )
         cmd_id = int(cur.lastrowid)
 
+    notify_commands(device_id)
     return {"accepted": True, "commandId": cmd_id, "createdAt": created_at}
 
 
-@app.post("/api/flora/{device_id}/telemetry", dependencies=[Depends(require_auth)])
-def post_telemetry(device_id: str, payload: TelemetryPush) -> dict[str, Any]:
-    _, cfg = get_or_create_device(device_id)
-
-    incoming = payload.snapshot.model_copy(deep=True)
+def store_snapshot(device_id: str, payload: TelemetryPush) -> None:
+    # The device only sends fields that left their deadband; merge them into the stored snapshot
+    current, _ = get_or_create_device(device_id)
+    changes = payload.snapshot.model_dump(include=payload.snapshot.model_fields_set)
     if payload.pumpRunning is not None:
-        incoming.pumpRunning = payload.pumpRunning
+        changes["pumpRunning"] = payload.pumpRunning
     if payload.alarmActive is not None:
-        incoming.alarmActive = payload.alarmActive
-    incoming.updatedAt = now_iso()
+        changes["alarmActive"] = payload.alarmActive
+    changes["updatedAt"] = now_iso()
+    merged = current.model_copy(update=changes)
 
     with db_conn() as conn:
         conn.execute(
             "UPDATE devices SET snapshot_json = ?, updated_at = ? WHERE device_id = ?",
-            (incoming.model_dump_json(), now_iso(), device_id),
+            (merged.model_dump_json(), now_iso(), device_id),
+        )
+        conn.execute(
+            "INSERT INTO telemetry_history(device_id, measured_at, received_at, snapshot_json) VALUES(?, ?, ?, ?)",
+            (device_id, merged.updatedAt, merged.updatedAt, merged.model_dump_json()),
         )
 
-    return {"stored": True, "config": cfg.model_dump()}
 
+def store_history(device_id: str, batch: TelemetryBatch) -> int:
+    current, _ = get_or_create_device(device_id)
+    received_at = now_iso()
+    rows = []
+    newest: tuple[str, PlantSnapshot] | None = None
+    for record in batch.records:
+        measured_at = (
+            datetime.fromtimestamp(record.measuredAt, timezone.utc).isoformat() if record.measuredAt > 0 else received_at
+        )
+        snapshot = record.snapshot.model_copy(update={"updatedAt": measured_at})
+        rows.append((device_id, measured_at, received_at, snapshot.model_dump_json()))
+        # Records without a device clock cannot be ordered against the live snapshot
+        if record.measuredAt > 0 and (newest is None or measured_at >= newest[0]):
+            newest = (measured_at, record.snapshot)
+
+    with db_conn() as conn:
+        conn.executemany(
+            "INSERT INTO telemetry_history(device_id, measured_at, received_at, snapshot_json) VALUES(?, ?, ?, ?)",
+            rows,
+        )
+        # Radio-off sensing wakes deliver fresh readings only through the batch
+        if newest is not None and newest[0] > current.updatedAt:
+            measured_at, snapshot = newest
+            changes = snapshot.model_dump(include=snapshot.model_fields_set)
+            changes["updatedAt"] = measured_at
+            conn.execute(
+                "UPDATE devices SET snapshot_json = ?, updated_at = ? WHERE device_id = ?",
+                (current.model_copy(update=changes).model_dump_json(), received_at, device_id),
+            )
+    return len(rows)
+
+
+def notify_commands(device_id: str) -> None:
+    event = command_events.pop(device_id, None)
+    if event is not None:
+        event.set()
+
+
+def decode_binary_snapshot(body: bytes) -> TelemetryPush:
+    if body and body[0] == 2:
+        return decode_binary_snapshot_v2(body)
+    if not body or body[0] != 1:
+        raise HTTPException(status_code=status.HTTP_415_UNSUPPORTED_MEDIA_TYPE, detail="Unknown telemetry version")
+    if len(body) != BINARY_SNAPSHOT_V1.size:
+        raise HTTPException(status_code=status.HTTP_422_UNPROCESSABLE_ENTITY, detail="Bad telemetry length")
+
+    _, flags, soil, water, battery_mv, temp_centi, humid_centi, failures, blocked_ms = BINARY_SNAPSHOT_V1.unpack(body)
+    return TelemetryPush(
+        snapshot=PlantSnapshot(
+            soilMoisturePercent=soil,
+            waterLevel=water,
+            batteryVoltage=battery_mv / 1000,
+            temperature=temp_centi / 100,
+            humidity=humid_centi / 100,
+            pumpRunning=bool(flags & 0x01),
+            alarmActive=bool(flags & 0x02),
+            backendFailures=failures,
+            backendBlockedMs=blocked_ms,
+        )
+    )
 
-@app.get("/api/flora/{device_id}/commands", response_model=CommandsResponse, dependencies=[Depends(require_auth)])
-def get_commands(device_id: str, after_id: int = 0, limit: int = 20) -> CommandsResponse:
-    get_or_create_device(device_id)
 
+def decode_binary_snapshot_v2(body: bytes) -> TelemetryPush:
+    if len(body) < BINARY_SNAPSHOT_V2_HEADER.size:
+        raise HTTPException(status_code=status.HTTP_422_UNPROCESSABLE_ENTITY, detail="Bad telemetry length")
+
+    _, flags, mask = BINARY_SNAPSHOT_V2_HEADER.unpack_from(body)
+    fields: dict[str, Any] = {"pumpRunning": bool(flags & 0x01), "alarmActive": bool(flags & 0x02)}
+    offset = BINARY_SNAPSHOT_V2_HEADER.size
+    for bit, layout, convert in BINARY_SNAPSHOT_V2_FIELDS:
+        if not mask & bit:
+            continue
+        if offset + layout.size > len(body):
+            raise HTTPException(status_code=status.HTTP_422_UNPROCESSABLE_ENTITY, detail="Bad telemetry length")
+        fields.update(convert(layout.unpack_from(body, offset)))
+        offset += layout.size
+    if offset != len(body):
+        raise HTTPException(status_code=status.HTTP_422_UNPROCESSABLE_ENTITY, detail="Bad telemetry length")
+    return TelemetryPush(snapshot=PlantSnapshot(**fields))
+
+
+def decode_binary_history(body: bytes) -> TelemetryBatch:
+    if not body or body[0] != 1:
+        raise HTTPException(status_code=status.HTTP_415_UNSUPPORTED_MEDIA_TYPE, detail="Unknown history version")
+    if len(body) < BINARY_HISTORY_V1_HEADER.size:
+        raise HTTPException(status_code=status.HTTP_422_UNPROCESSABLE_ENTITY, detail="Bad history length")
+    _, count = BINARY_HISTORY_V1_HEADER.unpack_from(body)
+    if len(body) != BINARY_HISTORY_V1_HEADER.size + count * BINARY_HISTORY_V1_RECORD.size:
+        raise HTTPException(status_code=status.HTTP_422_UNPROCESSABLE_ENTITY, detail="Bad history length")
+
+    records = []
+    for measured_at, flags, soil, water, battery_mv, temp_centi, humid_centi in BINARY_HISTORY_V1_RECORD.iter_unpack(
+        body[BINARY_HISTORY_V1_HEADER.size :]
+    ):
+        records.append(
+            HistoryRecord(
+                measuredAt=measured_at,
+                snapshot=PlantSnapshot(
+                    soilMoisturePercent=soil,
+                    waterLevel=water,
+                    batteryVoltage=battery_mv / 1000,
+                    temperature=temp_centi / 100,
+                    humidity=humid_centi / 100,
+                    pumpRunning=bool(flags & 0x01),
+                    alarmActive=bool(flags & 0x02),
+                ),
+            )
+        )
+    return TelemetryBatch(records=records)
+
+
+async def read_telemetry(request: Request) -> TelemetryPush:
+    body = await request.body()
+    content_type = request.headers.get("content-type", "").split(";")[0].strip().lower()
+    if content_type == BINARY_TELEMETRY_TYPE:
+        return decode_binary_snapshot(body)
+    try:
+        return TelemetryPush.model_validate_json(body)
+    except ValidationError as exc:
+        raise HTTPException(status_code=status.HTTP_422_UNPROCESSABLE_ENTITY, detail=exc.errors()) from exc
+
+
+def load_commands(device_id: str, after_id: int, limit: int) -> list[CommandItem]:
     limit = max(1, min(limit, 200))
     with db_conn() as conn:
         rows = conn.execute(
@@ -219,14 +469,110 @@ def get_commands(device_id: str, after_id: int = 0, limit: int = 20) -> Commands
             (device_id, after_id, limit),
         ).fetchall()
 
-    return CommandsResponse(
+    return [
+        CommandItem(
+            id=row["id"],
+            type=row["type"],
+            payload=json.loads(row["payload_json"]),
+            createdAt=row["created_at"],
+        )
+        for row in rows
+    ]
+
+
+@app.post("/api/flora/{device_id}/telemetry", dependencies=[Depends(require_auth)])
+async def post_telemetry(device_id: str, request: Request, response: Response) -> dict[str, Any]:
+    payload = await read_telemetry(request)
+    _, cfg = get_or_create_device(device_id)
+    store_snapshot(device_id, payload)
+    response.headers[POLL_HEADER] = poll_interval_ms(device_id)
+    return {"stored": True, "config": cfg.model_dump()}
+
+
+@app.post("/api/flora/{device_id}/telemetry/batch", dependencies=[Depends(require_auth)])
+async def post_telemetry_batch(device_id: str, request: Request, response: Response) -> dict[str, Any]:
+    body = await request.body()
+    content_type = request.headers.get("content-type", "").split(";")[0].strip().lower()
+    if content_type == BINARY_TELEMETRY_TYPE:
+        batch = decode_binary_history(body)
+    else:
+        try:
+            batch = TelemetryBatch.model_validate_json(body)
+        except ValidationError as exc:
+            raise HTTPException(status_code=status.HTTP_422_UNPROCESSABLE_ENTITY, detail=exc.errors()) from exc
+    get_or_create_device(device_id)
+    stored = store_history(device_id, batch)
+    response.headers[POLL_HEADER] = poll_interval_ms(device_id)
+    return {"stored": stored}
+
+
+@app.get("/api/flora/{device_id}/history", response_model=HistoryResponse, dependencies=[Depends(require_auth)])
+def get_history(device_id: str, limit: int = 100) -> HistoryResponse:
+    limit = max(1, min(limit, 1000))
+    with db_conn() as conn:
+        rows = conn.execute(
+            """
+            SELECT measured_at, received_at, snapshot_json
+            FROM telemetry_history
+            WHERE device_id = ?
+            ORDER BY measured_at DESC, id DESC
+            LIMIT ?
+            """,
+            (device_id, limit),
+        ).fetchall()
+
+    return HistoryResponse(
         items=[
-            CommandItem(
-                id=row["id"],
-                type=row["type"],
-                payload=json.loads(row["payload_json"]),
-                createdAt=row["created_at"],
+            HistoryItem(
+                measuredAt=row["measured_at"],
+                receivedAt=row["received_at"],
+                snapshot=PlantSnapshot(**json.loads(row["snapshot_json"])),
             )
             for row in rows
         ]
     )
+
+
+@app.post("/api/flora/{device_id}/sync", response_model=SyncResponse, dependencies=[Depends(require_auth)])
+async def post_sync(
+    device_id: str,
+    request: Request,
+    response: Response,
+    after_id: int = 0,
+    limit: int = 20,
+    config_version: int = 0,
+) -> SyncResponse:
+    payload = await read_telemetry(request)
+    _, cfg = get_or_create_device(device_id)
+    store_snapshot(device_id, payload)
+    version = load_config_version(device_id)
+    response.headers[POLL_HEADER] = poll_interval_ms(device_id)
+    return SyncResponse(
+        stored=True,
+        configVersion=version,
+        config=None if config_version == version else cfg,
+        commands=load_commands(device_id, after_id, limit),
+    )
+
+
+@app.get("/api/flora/{device_id}/commands", response_model=CommandsResponse, dependencies=[Depends(require_auth)])
+async def get_commands(
+    device_id: str,
+    response: Response,
+    after_id: int = 0,
+    limit: int = 20,
+    wait: int = 0,
+) -> CommandsResponse:
+    get_or_create_device(device_id)
+    wait = max(0, min(wait, MAX_COMMAND_WAIT_S))
+    event = command_events.setdefault(device_id, asyncio.Event())
+    items = load_commands(device_id, after_id, limit)
+    if not items and wait > 0:
+        try:
+            await asyncio.wait_for(event.wait(), timeout=wait)
+        except asyncio.TimeoutError:
+            items = []
+        else:
+            items = load_commands(device_id, after_id, limit)
+    response.headers[POLL_HEADER] = poll_interval_ms(device_id)
+    return CommandsResponse(items=items)
@@ -8,6 +8,7 @@
 #include "AlarmManager.h"
 #include <Arduino.h>
 #include "DeviceConfig.h"
+#include "Scheduler.h"
 
 // Constants
 static const unsigned long BEEP_INTERVAL = 10000; // Interval between cycles (ms)
@@ -28,6 +29,12 @@ static bool lowWaterAlarm = false;
 static bool lowBatteryAlarm = false;
 static bool lowSoilAlarm = false;
 
+// Last evaluated inputs (used by alarmManagerReevaluate() after threshold changes)
+static int lastWaterLevel = -1;
+static float lastBatteryVoltage = -1.0f;
+static int lastSoilMoisture = -1;
+static bool hasInputs = false;
+
 static int beepCount = 0;
 static int beepsRemaining = 0;
 static bool buzzerOn = false;
@@ -49,15 +56,20 @@ void alarmManagerSetup() {
     lastBeepCycleTime = 0;
     beepsRemaining = 0;
     buzzerOn = false;
+    hasInputs = false;
 }
 
-bool alarmManagerUpdate(int waterLevel, float batteryVoltage, int soilMoisture) {
+bool alarmManagerEvaluate(int waterLevel, float batteryVoltage, int soilMoisture) {
     // If buzzer is not configured, do nothing
     if (buzzerPin == 255) {
         return false;
     }
 
-    unsigned long currentTime = millis();
+    lastWaterLevel = waterLevel;
+    lastBatteryVoltage = batteryVoltage;
+    lastSoilMoisture = soilMoisture;
+    hasInputs = true;
+
     bool previousAlarmState = isAlarmActive;
 
     // --- Check alarm conditions ---
@@ -97,15 +109,34 @@ bool alarmManagerUpdate(int waterLevel, float batteryVoltage, int soilMoisture)
                       isAlarmActive   ? "ACTIVE" : "INACTIVE");
     }
 
+    // If alarm just activated, prepare new beep cycle (buzzer runs in alarmManagerUpdate())
+    if (isAlarmActive && !previousAlarmState && configIsAlarmSoundEnabled()) {
+        Serial.println("[Alarm] ALARM ACTIVATED! Starting beeping.");
+        lastBeepCycleTime = millis() - BEEP_INTERVAL - 1;
+    }
+
+    return (isAlarmActive != previousAlarmState);
+}
+
+bool alarmManagerReevaluate() {
+    if (!hasInputs) {
+        return false;
+    }
+    return alarmManagerEvaluate(lastWaterLevel, lastBatteryVoltage, lastSoilMoisture);
+}
+
+void alarmManagerUpdate() {
+    // If buzzer is not configured, do nothing
+    if (buzzerPin == 255) {
+        return;
+    }
+
+    unsigned long currentTime = millis();
+
     // --- Buzzer control ---
     bool soundEnabled = configIsAlarmSoundEnabled();
 
     if (isAlarmActive && soundEnabled) {
-        // If alarm just activated, prepare new beep cycle
-        if (!previousAlarmState) {
-            Serial.println("[Alarm] ALARM ACTIVATED! Starting beeping.");
-            lastBeepCycleTime = currentTime - BEEP_INTERVAL - 1;
-        }
         // New cycle
         if (currentTime - lastBeepCycleTime >= BEEP_INTERVAL && beepsRemaining == 0) {
             // Set number of beeps according to priority
@@ -143,10 +174,30 @@ bool alarmManagerUpdate(int waterLevel, float batteryVoltage, int soilMoisture)
             }
         }
     }
-
-    return (isAlarmActive != previousAlarmState);
 }
 
 bool alarmManagerIsAlarmActive() {
     return isAlarmActive;
+}
+
+uint32_t alarmManagerNextUpdateMs() {
+    if (buzzerPin == 255 || !isAlarmActive || !configIsAlarmSoundEnabled()) {
+        return SCHEDULER_IDLE;
+    }
+
+    unsigned long currentTime = millis();
+    unsigned long elapsed;
+    unsigned long interval;
+
+    if (beepsRemaining > 0) {
+        // Beep in progress - next edge after pause or beep duration
+        elapsed  = currentTime - buzzerStateChangeTime;
+        interval = buzzerOn ? BEEP_DURATION : BEEP_PAUSE;
+    } else {
+        // Waiting for the next beep cycle
+        elapsed  = currentTime - lastBeepCycleTime;
+        interval = BEEP_INTERVAL;
+    }
+
+    return (elapsed >= interval) ? 0 : (uint32_t)(interval - elapsed);
 }
\ No newline at end of file
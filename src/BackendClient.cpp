@@ -0,0 +1,376 @@
+// BackendClient.cpp
+#include "BackendClient.h"
+#include <WiFi.h>
+#include <WiFiClient.h>
+#include <stdarg.h>
+
+// Kontrola sterty: w buildach testowych każda wymiana loguje zmianę wolnej sterty.
+// Wymiana nie alokuje, więc stała niezerowa różnica oznacza wyciek w tym module.
+#if !defined(FLORA_BACKEND_HEAP_CHECK) && defined(TEST_MODE)
+#define FLORA_BACKEND_HEAP_CHECK 1
+#endif
+
+static const uint16_t CONNECT_TIMEOUT_MS = 2000;
+// Po tylu kolejnych błędach transportu zapominamy IP i pytamy DNS ponownie
+static const uint8_t  MAX_FAILURES_BEFORE_RESOLVE = 2;
+
+static const size_t REQUEST_HEAD_SIZE = 512;   // Linia zapytania + wszystkie nagłówki
+static const size_t RESPONSE_LINE_SIZE = 128;  // Dłuższe linie nagłówków są przycinane
+
+// Private variables (wspólne dla wszystkich sesji, tylko do odczytu po backendClientSetup())
+static char       host[64] = "";
+static char       basePath[64] = "";
+static uint16_t   port = 80;
+static char       fixedHeaders[256] = "";  // Host + Authorization + Connection - składane raz
+static IPAddress  literalIp;               // Adres, gdy host w URL jest już adresem IP
+static bool       hostIsIp = false;
+
+// Treść odpowiedzi ograniczona do Content-Length - parser nie wyczyta kolejnej odpowiedzi z gniazda,
+// a po nim łatwo dopić resztę (warunek reużycia gniazda)
+class BodyStream : public Stream {
+public:
+    BodyStream(Stream& source, int length) : source(source), remaining(length) {}
+
+    int available() override {
+        if (remaining == 0) return 0;
+        int n = source.available();
+        return (remaining > 0 && n > remaining) ? remaining : n;
+    }
+    int read() override {
+        if (remaining == 0) return -1;
+        int c = source.read();
+        if (c >= 0 && remaining > 0) remaining--;
+        return c;
+    }
+    int peek() override { return remaining == 0 ? -1 : source.peek(); }
+    size_t write(uint8_t) override { return 0; }
+
+    // Odrzuca nieprzeczytaną resztę; false = długość nieznana, gniazda nie da się użyć ponownie
+    bool drain(unsigned long timeoutMs) {
+        if (remaining < 0) return false;
+        const unsigned long started = millis();
+        while (remaining > 0 && millis() - started < timeoutMs) {
+            if (source.available() > 0) {
+                source.read();
+                remaining--;
+            } else {
+                delay(1);
+            }
+        }
+        return remaining == 0;
+    }
+
+private:
+    Stream& source;
+    int     remaining;   // -1 = brak Content-Length
+};
+
+bool backendClientSetup(const char* baseUrl, const char* token) {
+    const char* p = baseUrl;
+    if (strncmp(p, "http://", 7) == 0) {
+        p += 7;
+    } else if (strstr(p, "://") != nullptr) {
+        // Zapytania składamy sami na gołym TCP - bez TLS (https://) host byłby rozebrany jako "https"
+        Serial.printf("[Backend] BŁĄD: Nieobsługiwany adres '%s' - tylko http://. Backend wyłączony.\n", baseUrl);
+        return false;
+    }
+
+    // host[:port][/ścieżka]
+    size_t hostLen = strcspn(p, ":/");
+    snprintf(host, sizeof(host), "%.*s", (int)hostLen, p);
+    p += hostLen;
+    if (*p == ':') {
+        port = (uint16_t)atoi(p + 1);
+        p += strcspn(p, "/");
+    }
+    snprintf(basePath, sizeof(basePath), "%s", p);
+    size_t baseLen = strlen(basePath);
+    if (baseLen > 0 && basePath[baseLen - 1] == '/') basePath[baseLen - 1] = '\0';
+
+    snprintf(fixedHeaders, sizeof(fixedHeaders),
+             "Host: %s:%u\r\nAuthorization: Bearer %s\r\nConnection: keep-alive\r\n", host, port, token);
+    hostIsIp = literalIp.fromString(host);
+
+    if (host[0] == '\0' || port == 0) {
+        Serial.printf("[Backend] BŁĄD: Niepoprawny adres backendu '%s'. Backend wyłączony.\n", baseUrl);
+        return false;
+    }
+    Serial.printf("[Backend] Serwer HTTP: host=%s port=%u prefiks='%s'\n", host, port, basePath);
+    return true;
+}
+
+void backendClientSessionInit(BackendSession& session, const char* name) {
+    session.name = name;
+    session.ip = literalIp;
+    session.ipValid = hostIsIp;
+    session.consecutiveFailures = 0;
+    session.lastETag[0] = '\0';
+    session.pollHintMs = 0;
+    session.serverTime = 0;
+}
+
+void backendClientReset(BackendSession& session) {
+    session.tcp.stop();
+    session.ip = literalIp;
+    session.ipValid = hostIsIp;
+    session.consecutiveFailures = 0;
+}
+
+// Zapewnia otwarte gniazdo do zbuforowanego IP (bez DNS przy każdym zapytaniu)
+static bool ensureConnected(BackendSession& s) {
+    if (s.tcp.connected()) return true;
+
+    if (!s.ipValid) {
+        if (WiFi.hostByName(host, s.ip) != 1) {
+            Serial.printf("[Backend:%s] DNS: nie udało się rozwiązać %s\n", s.name, host);
+            return false;
+        }
+        s.ipValid = true;
+        Serial.printf("[Backend:%s] DNS: %s -> %s\n", s.name, host, s.ip.toString().c_str());
+    }
+
+    if (!s.tcp.connect(s.ip, port, CONNECT_TIMEOUT_MS)) {
+        return false;
+    }
+    s.tcp.setNoDelay(true);
+    return true;
+}
+
+// Dopisuje sformatowany fragment do bufora; false = bufor za mały
+static bool appendf(char* buf, size_t size, size_t& used, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf + used, size - used, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= size - used) return false;
+    used += n;
+    return true;
+}
+
+// Czyta jedną linię (bez "\r\n"); zbyt długa linia jest przycinana do rozmiaru bufora
+// @param received Jeśli podany: czy z gniazda przyszedł choć jeden bajt (także przy błędzie)
+static bool readLine(WiFiClient& tcp, char* buf, size_t size, unsigned long started, uint16_t timeoutMs,
+                     bool* received = nullptr) {
+    size_t n = 0;
+    for (;;) {
+        if (tcp.available() <= 0) {
+            if (!tcp.connected() || millis() - started >= timeoutMs) return false;
+            delay(1);
+            continue;
+        }
+        int c = tcp.read();
+        if (received != nullptr) *received = true;
+        if (c == '\n') break;
+        if (c != '\r' && n + 1 < size) buf[n++] = (char)c;
+    }
+    buf[n] = '\0';
+    return true;
+}
+
+// Jeśli linia to nagłówek `name` (wielkość liter bez znaczenia), zwraca jego wartość
+static const char* headerValue(const char* line, const char* name) {
+    size_t len = strlen(name);
+    if (strncasecmp(line, name, len) != 0 || line[len] != ':') return nullptr;
+    const char* value = line + len + 1;
+    while (*value == ' ') value++;
+    return value;
+}
+
+// Dni od 1970-01-01 dla daty kalendarzowej (bez timegm() i strefy czasowej)
+static int64_t daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const int yoe = year - era * 400;
+    const int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// Nagłówek Date w formacie IMF-fixdate, np. "Sun, 06 Nov 1994 08:49:37 GMT"; 0 = nie do odczytania
+static time_t parseHttpDate(const char* value) {
+    static const char MONTHS[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    char month[4] = "";
+    int day, year, hour, minute, second;
+    if (sscanf(value, "%*3s, %d %3s %d %d:%d:%d", &day, month, &year, &hour, &minute, &second) != 6) return 0;
+
+    const char* found = strstr(MONTHS, month);
+    if (found == nullptr || strlen(month) != 3 || (found - MONTHS) % 3 != 0) return 0;
+    const int monthNumber = (int)(found - MONTHS) / 3 + 1;
+
+    const int64_t days = daysFromCivil(year, monthNumber, day);
+    return (time_t)(days * 86400 + hour * 3600 + minute * 60 + second);
+}
+
+// @param retryable Ustawiane na true, gdy serwer na pewno nie przetworzył zapytania: zapis się nie
+//                  udał albo połączenie zamknięto, zanim przyszedł choć bajt odpowiedzi
+static int sendOnce(BackendSession& s, const char* method, const char* uri, const char* contentType, const char* etag,
+                    const uint8_t* body, size_t length, BackendBodyReader reader, void* context, uint16_t timeoutMs,
+                    bool& retryable) {
+    retryable = false;
+    // --- Zapytanie: stały bufor na stosie, stałe nagłówki skopiowane z fixedHeaders ---
+    char head[REQUEST_HEAD_SIZE];
+    size_t used = 0;
+    bool fits = appendf(head, sizeof(head), used, "%s %s%s HTTP/1.1\r\n%s", method, basePath, uri, fixedHeaders);
+    if (contentType != nullptr) fits = fits && appendf(head, sizeof(head), used, "Content-Type: %s\r\n", contentType);
+    if (etag != nullptr) fits = fits && appendf(head, sizeof(head), used, "If-None-Match: %s\r\n", etag);
+    if (body != nullptr) fits = fits && appendf(head, sizeof(head), used, "Content-Length: %u\r\n", (unsigned)length);
+    fits = fits && appendf(head, sizeof(head), used, "\r\n");
+    if (!fits) {
+        Serial.printf("[Backend:%s] Zapytanie nie mieści się w buforze: %s\n", s.name, uri);
+        return HTTPC_ERROR_TOO_LESS_RAM;
+    }
+
+    if (s.tcp.write((const uint8_t*)head, used) != used) {
+        s.tcp.stop();
+        retryable = true;
+        return HTTPC_ERROR_SEND_HEADER_FAILED;
+    }
+    if (length > 0 && s.tcp.write(body, length) != length) {
+        s.tcp.stop();
+        retryable = true;   // Niepełna treść - serwer nie ma czego przetworzyć
+        return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+    }
+
+    // --- Linia statusu ---
+    const unsigned long started = millis();
+    char line[RESPONSE_LINE_SIZE];
+    bool received = false;
+    if (!readLine(s.tcp, line, sizeof(line), started, timeoutMs, &received)) {
+        const int error = s.tcp.connected() ? HTTPC_ERROR_READ_TIMEOUT : HTTPC_ERROR_CONNECTION_LOST;
+        // Timeout albo urwana odpowiedź: serwer mógł już wykonać zapytanie (POST nie jest idempotentny)
+        retryable = (error == HTTPC_ERROR_CONNECTION_LOST && !received);
+        s.tcp.stop();
+        return error;
+    }
+    if (strncmp(line, "HTTP/1.", 7) != 0 || strlen(line) < 12) {
+        s.tcp.stop();
+        return HTTPC_ERROR_NO_HTTP_SERVER;
+    }
+    const int httpCode = atoi(line + 9);
+    bool keepAlive = (line[7] == '1');   // HTTP/1.0 zamyka połączenie domyślnie
+
+    // --- Nagłówki: interesują nas tylko te, które zmieniają obsługę odpowiedzi ---
+    int contentLength = -1;
+    for (;;) {
+        if (!readLine(s.tcp, line, sizeof(line), started, timeoutMs)) {
+            s.tcp.stop();
+            return HTTPC_ERROR_READ_TIMEOUT;
+        }
+        if (line[0] == '\0') break;
+
+        const char* value;
+        if ((value = headerValue(line, "Content-Length")) != nullptr) {
+            contentLength = atoi(value);
+        } else if ((value = headerValue(line, "ETag")) != nullptr) {
+            snprintf(s.lastETag, sizeof(s.lastETag), "%s", value);
+        } else if ((value = headerValue(line, "X-Flora-Poll-Ms")) != nullptr) {
+            s.pollHintMs = (uint32_t)strtoul(value, nullptr, 10);
+        } else if ((value = headerValue(line, "Date")) != nullptr) {
+            s.serverTime = parseHttpDate(value);
+        } else if ((value = headerValue(line, "Connection")) != nullptr) {
+            keepAlive = (strncasecmp(value, "close", 5) != 0);
+        } else if ((value = headerValue(line, "Transfer-Encoding")) != nullptr) {
+            contentLength = -1;   // chunked - nie dekodujemy, gniazdo zamykamy po odczycie
+            keepAlive = false;
+        }
+    }
+    if (httpCode == HTTP_CODE_NOT_MODIFIED || httpCode == 204 || strcmp(method, "HEAD") == 0) {
+        contentLength = 0;
+    }
+
+    // --- Treść: do odbiorcy (2xx) albo w całości pominięta ---
+    BodyStream bodyStream(s.tcp, contentLength);
+    bodyStream.setTimeout(timeoutMs);
+    if (reader != nullptr && httpCode >= 200 && httpCode < 300) {
+        reader(bodyStream, context);
+    }
+    if (!bodyStream.drain(timeoutMs) || !keepAlive) {
+        s.tcp.stop();
+    }
+    return httpCode;
+}
+
+static int sendRequest(BackendSession& s, const char* method, const char* path, const char* contentType, const char* etag,
+                       const uint8_t* body, size_t length, BackendBodyReader reader, void* context, uint16_t timeoutMs) {
+#if FLORA_BACKEND_HEAP_CHECK
+    const uint32_t heapBefore = ESP.getFreeHeap();
+#endif
+
+    const bool reused = s.tcp.connected();
+    if (!ensureConnected(s)) {
+        if (++s.consecutiveFailures >= MAX_FAILURES_BEFORE_RESOLVE) backendClientReset(s);
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+
+    s.lastETag[0] = '\0';
+    s.pollHintMs = 0;
+    s.serverTime = 0;
+    bool retryable;
+    int httpCode = sendOnce(s, method, path, contentType, etag, body, length, reader, context, timeoutMs, retryable);
+
+    // Serwer mógł w międzyczasie zamknąć bezczynne połączenie - jedna ponowna próba na świeżym gnieździe,
+    // ale tylko gdy zapytanie na pewno do niego nie dotarło (bez duplikatów POST i podwójnego long-polla)
+    if (httpCode <= 0 && reused && retryable && ensureConnected(s)) {
+        httpCode = sendOnce(s, method, path, contentType, etag, body, length, reader, context, timeoutMs, retryable);
+    }
+
+    if (httpCode > 0) {
+        s.consecutiveFailures = 0;
+    } else if (++s.consecutiveFailures >= MAX_FAILURES_BEFORE_RESOLVE) {
+        backendClientReset(s);
+    }
+
+#if FLORA_BACKEND_HEAP_CHECK
+    // Bufory TCP/IP mogą chwilowo zostać zajęte (np. niepotwierdzone segmenty) - liczy się stała różnica
+    const int32_t heapDelta = (int32_t)ESP.getFreeHeap() - (int32_t)heapBefore;
+    if (heapDelta != 0) {
+        Serial.printf("[Backend:%s] Sterta: %+ld B po %s %s\n", s.name, (long)heapDelta, method, path);
+    }
+#endif
+    return httpCode;
+}
+
+int backendClientGet(BackendSession& session, const char* path, const char* etag,
+                     BackendBodyReader reader, void* context, uint16_t timeoutMs) {
+    return sendRequest(session, "GET", path, nullptr, etag, nullptr, 0, reader, context, timeoutMs);
+}
+
+int backendClientPost(BackendSession& session, const char* path, const char* contentType,
+                      const uint8_t* body, size_t length, BackendBodyReader reader, void* context,
+                      uint16_t timeoutMs) {
+    // Pusta treść POST też musi mieć Content-Length (inaczej serwer czeka na treść)
+    static const uint8_t EMPTY_BODY = 0;
+    return sendRequest(session, "POST", path, contentType, nullptr, body ? body : &EMPTY_BODY, length,
+                       reader, context, timeoutMs);
+}
+
+int backendClientPut(BackendSession& session, const char* path, const char* contentType,
+                     const uint8_t* body, size_t length, BackendBodyReader reader, void* context,
+                     uint16_t timeoutMs) {
+    return sendRequest(session, "PUT", path, contentType, nullptr, body, length, reader, context, timeoutMs);
+}
+
+const char* backendClientLastETag(const BackendSession& session) {
+    return session.lastETag;
+}
+
+time_t backendClientLastServerTime(const BackendSession& session) {
+    return session.serverTime;
+}
+
+uint32_t backendClientLastPollHintMs(const BackendSession& session) {
+    return session.pollHintMs;
+}
+
+const char* backendClientErrorToString(int code) {
+    switch (code) {
+        case HTTPC_ERROR_CONNECTION_REFUSED:  return "connection refused";
+        case HTTPC_ERROR_SEND_HEADER_FAILED:  return "send header failed";
+        case HTTPC_ERROR_SEND_PAYLOAD_FAILED: return "send payload failed";
+        case HTTPC_ERROR_CONNECTION_LOST:     return "connection lost";
+        case HTTPC_ERROR_NO_HTTP_SERVER:      return "no HTTP server";
+        case HTTPC_ERROR_TOO_LESS_RAM:        return "request too long";
+        case HTTPC_ERROR_READ_TIMEOUT:        return "read timeout";
+        default:                              return code > 0 ? "ok" : "unknown error";
+    }
+}
@@ -0,0 +1,126 @@
+// BackendHealth.cpp
+#include "BackendHealth.h"
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+
+// Backoff: 2 s, 4 s, 8 s ... do 10 min
+static const uint32_t BACKOFF_BASE_MS = 2000;
+static const uint32_t BACKOFF_MAX_MS  = 10UL * 60UL * 1000UL;
+
+static const char* ENDPOINT_NAMES[BACKEND_EP_COUNT] = { "sync", "config", "commands", "history" };
+
+struct EndpointHealth {
+    BackendCircuitState state;
+    uint8_t             consecutiveFailures;
+    unsigned long       lastFailureTime;
+    uint32_t            backoffMs;          // Ile po lastFailureTime wstrzymujemy zapytania
+};
+
+// Private variables
+static EndpointHealth endpoints[BACKEND_EP_COUNT] = {};
+static uint32_t       totalFailures = 0;
+static uint32_t       totalBlockedMs = 0;
+static portMUX_TYPE   healthMux = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t backoffFor(uint8_t failures) {
+    uint32_t backoff = BACKOFF_BASE_MS;
+    for (uint8_t i = 1; i < failures && backoff < BACKOFF_MAX_MS; i++) backoff *= 2;
+    return min(backoff, BACKOFF_MAX_MS);
+}
+
+static uint32_t retryInLocked(const EndpointHealth& h, unsigned long now) {
+    if (h.consecutiveFailures == 0) return 0;
+    unsigned long since = now - h.lastFailureTime;
+    return since >= h.backoffMs ? 0 : h.backoffMs - since;
+}
+
+bool backendHealthAllow(BackendEndpoint ep) {
+    if (ep >= BACKEND_EP_COUNT) return true;
+
+    bool allowed;
+    bool probing = false;
+    portENTER_CRITICAL(&healthMux);
+    EndpointHealth& h = endpoints[ep];
+    if (h.state == BACKEND_CIRCUIT_HALF_OPEN) {
+        allowed = false;  // Zapytanie próbne już trwa
+    } else if (retryInLocked(h, millis()) > 0) {
+        allowed = false;
+    } else {
+        allowed = true;
+        if (h.state == BACKEND_CIRCUIT_OPEN) {
+            h.state = BACKEND_CIRCUIT_HALF_OPEN;
+            probing = true;
+        }
+    }
+    portEXIT_CRITICAL(&healthMux);
+
+    if (probing) {
+        Serial.printf("[Health] '%s': obwód półotwarty - zapytanie próbne.\n", ENDPOINT_NAMES[ep]);
+    }
+    return allowed;
+}
+
+void backendHealthReport(BackendEndpoint ep, bool success, uint32_t elapsedMs) {
+    if (ep >= BACKEND_EP_COUNT) return;
+
+    BackendCircuitState before, after;
+    uint32_t backoff;
+    portENTER_CRITICAL(&healthMux);
+    EndpointHealth& h = endpoints[ep];
+    before = h.state;
+    if (success) {
+        h.state = BACKEND_CIRCUIT_CLOSED;
+        h.consecutiveFailures = 0;
+        h.backoffMs = 0;
+    } else {
+        totalFailures++;
+        totalBlockedMs += elapsedMs;
+        if (h.consecutiveFailures < UINT8_MAX) h.consecutiveFailures++;
+        h.lastFailureTime = millis();
+        h.backoffMs = backoffFor(h.consecutiveFailures);
+        if (h.state == BACKEND_CIRCUIT_HALF_OPEN || h.consecutiveFailures >= BACKEND_HEALTH_TRIP_FAILURES) {
+            h.state = BACKEND_CIRCUIT_OPEN;
+        }
+    }
+    after = h.state;
+    backoff = h.backoffMs;
+    portEXIT_CRITICAL(&healthMux);
+
+    if (after == BACKEND_CIRCUIT_OPEN) {
+        Serial.printf("[Health] '%s': obwód OTWARTY, kolejna próba za %lu s (działam na konfiguracji z Flash).\n",
+                      ENDPOINT_NAMES[ep], (unsigned long)(backoff / 1000));
+    } else if (before != BACKEND_CIRCUIT_CLOSED && after == BACKEND_CIRCUIT_CLOSED) {
+        Serial.printf("[Health] '%s': backend znów odpowiada - obwód zamknięty.\n", ENDPOINT_NAMES[ep]);
+    }
+}
+
+uint32_t backendHealthRetryInMs(BackendEndpoint ep) {
+    if (ep >= BACKEND_EP_COUNT) return 0;
+    portENTER_CRITICAL(&healthMux);
+    uint32_t retryIn = retryInLocked(endpoints[ep], millis());
+    portEXIT_CRITICAL(&healthMux);
+    return retryIn;
+}
+
+// Odczyty też pod muteksem - snapshot koduje także loop() na drugim rdzeniu
+BackendCircuitState backendHealthState(BackendEndpoint ep) {
+    if (ep >= BACKEND_EP_COUNT) return BACKEND_CIRCUIT_CLOSED;
+    portENTER_CRITICAL(&healthMux);
+    BackendCircuitState state = endpoints[ep].state;
+    portEXIT_CRITICAL(&healthMux);
+    return state;
+}
+
+uint32_t backendHealthTotalFailures() {
+    portENTER_CRITICAL(&healthMux);
+    uint32_t failures = totalFailures;
+    portEXIT_CRITICAL(&healthMux);
+    return failures;
+}
+
+uint32_t backendHealthTotalBlockedMs() {
+    portENTER_CRITICAL(&healthMux);
+    uint32_t blockedMs = totalBlockedMs;
+    portEXIT_CRITICAL(&healthMux);
+    return blockedMs;
+}
@@ -1,213 +1,1497 @@
 #include "BackendTasks.h"
 #include "DeviceConfig.h"
+#include "Scheduler.h"
+#include "BackendClient.h"
+#include "BackendHealth.h"
+#include "TelemetryHistory.h"
+#include "LinkQuality.h"
+#include "PowerManager.h"
 #include <WiFi.h>
-#include <HTTPClient.h>
 #include <ArduinoJson.h>
+#include <stdarg.h>
+#include <time.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/event_groups.h>
+#include <freertos/semphr.h>
+
+#if __has_include("secrets.h")
 #include "secrets.h"
+#endif
+
+#ifndef FLORA_BACKEND_BASE_URL
+#define FLORA_BACKEND_BASE_URL "http://127.0.0.1:8080"
+#endif
+
+#ifndef FLORA_BACKEND_TOKEN
+#define FLORA_BACKEND_TOKEN "replace_me"
+#endif
+
+#ifndef FLORA_BACKEND_DEVICE_ID
+#define FLORA_BACKEND_DEVICE_ID "flora-1"
+#endif
+
+// 1 = snapshot wysyłany binarnie (16 B zamiast ~260 B JSON); backend bez dekodera -> powrót do JSON
+#ifndef FLORA_BINARY_TELEMETRY
+#define FLORA_BINARY_TELEMETRY 1
+#endif
 
 // Zewnętrzne funkcje do obsługi pompy
 extern void pumpControlManualTurnOn(uint32_t durationMs);
 
-// Zmienne do stoperów i komend
-static int g_lastCommandId = 0;
-static unsigned long g_lastCommandCheckTime = 0;
-const unsigned long COMMAND_CHECK_INTERVAL_MS = 2000; // Sprawdzanie komend co 2s
+// --- Parametry zadania sieciowego ---
+static const uint32_t    NET_TASK_STACK_SIZE = 8192;
+static const UBaseType_t NET_TASK_PRIORITY   = 1;
+static const BaseType_t  NET_TASK_CORE       = 0;   // Rdzeń 0 (PRO_CPU) - loop() działa na rdzeniu 1
+static const uint32_t    CMD_TASK_STACK_SIZE = 6144;
+
+static const UBaseType_t CONFIG_QUEUE_LENGTH  = 2;
+static const UBaseType_t COMMAND_QUEUE_LENGTH = 8;
+static const UBaseType_t EVENT_QUEUE_LENGTH   = 4;
+
+// Zdarzenia (alarm, pompa) idą od razu; nieudana wysyłka jest ponawiana po 1, 2, 4 s,
+// a po ostatniej próbie zdarzenie trafia do historii RTC
+static const uint8_t  EVENT_MAX_ATTEMPTS    = 4;
+static const uint32_t EVENT_RETRY_BASE_MS   = 1000;
+
+// Pola konfiguracji, które rozumie firmware - filtr parsera odrzuca resztę jeszcze w strumieniu
+static const char* const CONFIG_KEYS[] = {
+    "continuousMode", "pumpDurationMs", "soilThresholdPercent", "lowBatteryMilliVolts",
+    "lowSoilPercent", "waterLevelThreshold", "alarmSoundEnabled", "soilDryAdc",
+    "soilWetAdc", "pumpPowerPercent", "measurementHour", "measurementMinute",
+};
+static const size_t CONFIG_KEY_COUNT = sizeof(CONFIG_KEYS) / sizeof(CONFIG_KEYS[0]);
+
+// Pojemności dokumentów JSON (stałe, na stosie zadania). Przy czytaniu ze strumienia klucze i napisy
+// są kopiowane do dokumentu - stąd zapas na ~200 znaków nazw pól konfiguracji i kilka w komendach.
+static const size_t CONFIG_JSON_CAPACITY   = JSON_OBJECT_SIZE(CONFIG_KEY_COUNT) + 256;
+static const size_t COMMANDS_JSON_CAPACITY = JSON_ARRAY_SIZE(COMMAND_QUEUE_LENGTH) +
+                                             COMMAND_QUEUE_LENGTH * (JSON_OBJECT_SIZE(3) + JSON_OBJECT_SIZE(1)) + 64;
+static const size_t FILTER_JSON_CAPACITY   = 384;
+
+const unsigned long CONFIG_CHECK_INTERVAL_MS  = 2000; // Pobieranie konfiguracji co 2s (dopóki serwer nie poda innego interwału)
+const unsigned long COMMAND_CHECK_INTERVAL_MS = 2000; // Odstęp odpytywania komend, gdy serwer nie wspiera long-poll
+
+// Long-poll komend: serwer trzyma zapytanie do LONG_POLL_WAIT_S, odczyt czeka o margines dłużej
+static const uint8_t  LONG_POLL_WAIT_S     = 25;
+static const uint16_t LONG_POLL_TIMEOUT_MS = LONG_POLL_WAIT_S * 1000 + 5000;
+// Granice interwału z nagłówka X-Flora-Poll-Ms (ochrona przed błędną wartością z serwera)
+static const uint32_t MIN_POLL_INTERVAL_MS = 1000;
+static const uint32_t MAX_POLL_INTERVAL_MS = 30UL * 60UL * 1000UL;
+
+// Pusta odpowiedź szybsza niż to = serwer nie trzymał zapytania (stary backend albo pełna kolejka)
+static const unsigned long LONG_POLL_MIN_HOLD_MS = 1000;
+
+static const EventBits_t SYNC_DONE_BIT = BIT0;
+
+// --- Bity obecności pól w BackendConfig ---
+enum : uint16_t {
+    CFG_CONTINUOUS_MODE   = 1 << 0,
+    CFG_PUMP_DURATION     = 1 << 1,
+    CFG_SOIL_THRESHOLD    = 1 << 2,
+    CFG_LOW_BATTERY       = 1 << 3,
+    CFG_LOW_SOIL          = 1 << 4,
+    CFG_WATER_THRESHOLD   = 1 << 5,
+    CFG_ALARM_SOUND       = 1 << 6,
+    CFG_SOIL_DRY_ADC      = 1 << 7,
+    CFG_SOIL_WET_ADC      = 1 << 8,
+    CFG_PUMP_POWER        = 1 << 9,
+    CFG_MEASUREMENT_TIME  = 1 << 10,
+};
+
+// Konfiguracja odebrana z serwera (przekazywana do loop() przez kolejkę)
+struct BackendConfig {
+    uint32_t version = 0;          // Wersja (ETag) konfiguracji na serwerze, 0 = nieznana
+    uint16_t present = 0;
+    bool     continuousMode = false;
+    uint32_t pumpDurationMs = 0;
+    int      soilThresholdPercent = 0;
+    int      lowBatteryMilliVolts = 0;
+    int      lowSoilPercent = 0;
+    uint16_t waterLevelThreshold = 0;
+    bool     alarmSoundEnabled = false;
+    int      soilDryAdc = 0;
+    int      soilWetAdc = 0;
+    int      pumpPowerPercent = 0;
+    int      measurementHour = 0;
+    int      measurementMinute = 0;
+};
+
+enum BackendCommandType : uint8_t {
+    BACKEND_CMD_UNKNOWN = 0,
+    BACKEND_CMD_PUMP,
+};
+
+// Pojedyncza komenda z aplikacji
+struct BackendCommand {
+    int                id;
+    BackendCommandType type;
+    uint32_t           durationMs;
+};
+
+// Snapshot do wysłania (stan pompy/alarmu zamrożony w chwili pomiaru)
+struct TelemetryRequest {
+    SensorData data;
+    bool       pumpRunning;
+    bool       alarmActive;
+    uint32_t   measuredAt;     // Czas Unix pomiaru (s), 0 = zegar nieustawiony
+    BackendEvent event;        // BACKEND_EVENT_NONE = rutynowy pomiar
+};
+
+// Snapshot w jednostkach stałoprzecinkowych - wspólna podstawa obu formatów i martwych stref
+struct EncodedSnapshot {
+    uint8_t  flags;                // SNAPSHOT_FLAG_*
+    int8_t   soilMoisturePercent;  // -1 = błąd odczytu
+    int8_t   waterLevel;           // -1 = błąd odczytu
+    uint16_t batteryMilliVolts;    // 0 = błąd odczytu
+    int16_t  temperatureCentiC;    // 0.01 °C (0 gdy DHT nie działa)
+    uint16_t humidityCentiPercent; // 0.01 %
+    uint16_t backendFailures;      // Nasycone na 65535
+    uint32_t backendBlockedMs;
+    int8_t   wifiRssi;             // dBm, 0 = brak odczytu
+    uint16_t linkRttMs;
+    uint16_t uploadDeferrals;
+    uint32_t measuredAt;           // Tylko dla historii - bieżący snapshot dostaje czas serwera
+};
+
+enum : uint8_t {
+    SNAPSHOT_FLAG_PUMP_RUNNING = 1 << 0,
+    SNAPSHOT_FLAG_ALARM_ACTIVE = 1 << 1,
+    SNAPSHOT_FLAG_DHT_VALID    = 1 << 2,
+};
+
+// Pola snapshotu wysyłane tylko po zmianie (stan pompy/alarmu idzie zawsze - to jeden bajt flag)
+enum : uint8_t {
+    SNAPSHOT_FIELD_SOIL        = 1 << 0,
+    SNAPSHOT_FIELD_WATER       = 1 << 1,
+    SNAPSHOT_FIELD_BATTERY     = 1 << 2,
+    SNAPSHOT_FIELD_TEMPERATURE = 1 << 3,
+    SNAPSHOT_FIELD_HUMIDITY    = 1 << 4,
+    SNAPSHOT_FIELD_HEALTH      = 1 << 5,   // backendFailures + backendBlockedMs
+    SNAPSHOT_FIELD_LINK        = 1 << 6,   // wifiRssi + linkRttMs + uploadDeferrals
+    SNAPSHOT_FIELD_ALL         = 0x7F,
+};
+
+// --- Martwe strefy: zmiana mniejsza lub równa nie jest wysyłana (porównanie z ostatnio potwierdzoną) ---
+static const int DEADBAND_SOIL_PERCENT      = 1;
+static const int DEADBAND_BATTERY_MV        = 20;
+static const int DEADBAND_TEMPERATURE_CENTI = 50;    // 0.5 °C
+static const int DEADBAND_HUMIDITY_CENTI    = 200;   // 2 %
+static const int DEADBAND_RSSI_DBM          = 6;
+static const int DEADBAND_RTT_MS            = 250;
+// Najdłuższa przerwa bez pełnego snapshotu (serwer wie, że urządzenie żyje, nawet gdy nic się nie zmienia)
+static const unsigned long TELEMETRY_HEARTBEAT_MS = 15UL * 60UL * 1000UL;
+
+// --- Binarny snapshot (application/x-flora-telemetry) ---
+// Little-endian (natywny porządek ESP32): version u8, flags u8, fields u8 (SNAPSHOT_FIELD_*), potem
+// obecne pola w kolejności bitów: soil i8, water i8, battery u16, temperature i16, humidity u16,
+// health u16+u32, link i8+u16+u16. Zmiana układu = nowa wersja; dekoder w mobile_backend/app.py musi zmienić się razem z nim.
+static const char*   TELEMETRY_BINARY_TYPE    = "application/x-flora-telemetry";
+static const uint8_t TELEMETRY_BINARY_VERSION = 2;
+static const size_t  BINARY_SNAPSHOT_MAX_SIZE = 3 + 1 + 1 + 2 + 2 + 2 + 6 + 5;
+
+// --- Historia z pamięci RTC (POST /telemetry/batch) ---
+// Binarnie: version u8, count u8, potem count rekordów: measuredAt u32, flags u8, soil i8, water i8,
+// battery u16, temperature i16, humidity u16. JSON: {"records":[{"measuredAt":...,<pola snapshotu>}]}
+static const uint8_t HISTORY_BINARY_VERSION  = 1;
+static const size_t  HISTORY_BINARY_RECORD_SIZE = 4 + 1 + 1 + 1 + 2 + 2 + 2;
+static const size_t  HISTORY_PAYLOAD_SIZE    = 1024;   // Binarnie cała historia (~630 B), JSON w kilku porcjach
+static const uint8_t HISTORY_RECORD_FIELDS  = SNAPSHOT_FIELD_ALL & ~(SNAPSHOT_FIELD_HEALTH | SNAPSHOT_FIELD_LINK);
+// Słabe łącze: kolejna próba rutynowej wysyłki po tym czasie (tryb ciągły)
+static const uint32_t LINK_DEFER_RETRY_MS    = 60000;
+// Czas systemowy wcześniejszy niż to = zegar jeszcze nie zsynchronizowany (NTP/RTC)
+static const time_t  MIN_VALID_UNIX_TIME     = 1700000000;
+
+// --- Stan współdzielony (tylko uchwyty kolejek, dane płyną kopiami) ---
+static TaskHandle_t       s_netTask        = nullptr;
+static TaskHandle_t       s_cmdTask        = nullptr; // Kanał komend (long-poll), tylko w trybie ciągłym
+static QueueHandle_t      s_telemetryQueue = nullptr; // loop() -> sieć (skrzynka, długość 1)
+static QueueHandle_t      s_configQueue    = nullptr; // sieć -> loop()
+static QueueHandle_t      s_commandQueue   = nullptr; // sieć -> loop()
+static QueueHandle_t      s_eventQueue     = nullptr; // loop() -> sieć (zdarzenia, przed rutynową telemetrią)
+static QueueHandle_t      s_configPushQueue = nullptr; // loop() -> sieć (konfiguracja z lokalnego API, skrzynka)
+static EventGroupHandle_t s_syncEvents     = nullptr;
+static volatile bool      s_syncRequested  = false;
+static volatile bool      s_listenWindow   = false; // Wybudzenie nasłuchu: synchronizacja = tylko komendy
+static SemaphoreHandle_t  s_commandMutex   = nullptr; // Kursor komend zmieniają oba zadania sieciowe
+static bool               s_clientReady    = false;   // false = błędny adres backendu, zadania nie startują
+
+// --- Stan prywatny zadań sieciowych ---
+static volatile int  s_fetchCursorId        = 0; // Ostatnie ID komendy przekazane do loop() (pod s_commandMutex)
+static uint32_t      s_knownConfigVersion   = 0; // Ostatnia wersja konfiguracji przekazana do loop()
+static unsigned long s_lastConfigCheckTime  = 0;
+static volatile uint32_t s_pollIntervalMs   = CONFIG_CHECK_INTERVAL_MS; // Interwał zalecany przez serwer
+static volatile uint32_t s_configPollDelayMs = CONFIG_CHECK_INTERVAL_MS; // Bieżący odstęp (z jitterem)
+static bool          s_firstPollDone        = false;
+static bool          s_wifiWasConnected     = false;
+static bool          s_binaryTelemetry      = FLORA_BINARY_TELEMETRY; // false po odrzuceniu przez serwer
+static EncodedSnapshot s_ackedSnapshot;          // Wartości ostatnio potwierdzone przez serwer
+static bool          s_hasAckedSnapshot     = false;
+static unsigned long s_lastFullSnapshotTime = 0;
+static uint8_t       s_eventAttempts        = 0;  // Nieudane próby wysłania zdarzenia z czoła kolejki
+static unsigned long s_eventRetryAt         = 0;
+static bool          s_historySupported     = true;  // false po 404 (backend bez /telemetry/batch)
+static bool          s_syncSupported        = true;  // false po 404 (backend bez /sync)
+static TelemetryRecord s_historyBatch[TELEMETRY_HISTORY_CAPACITY]; // Statycznie - nie obciąża stosu zadania
+static uint8_t       s_historyPayload[HISTORY_PAYLOAD_SIZE];
+static BackendSession s_netSession;              // Telemetry + konfiguracja (+ komendy przy synchronizacji)
+static BackendSession s_cmdSession;              // Long-poll komend - osobne gniazdo
+
+// Ścieżki endpointów (składane raz w backendTasksSetup)
+static char s_telemetryPath[96];
+static char s_configPath[96];
+static char s_commandsPath[96];   // Bez parametru after_id
+static char s_syncPath[96];       // Bez parametrów after_id/limit
+static char s_historyPath[96];
+
+// Filtry parsera (budowane raz w backendTasksSetup, potem tylko do odczytu przez oba zadania)
+static StaticJsonDocument<FILTER_JSON_CAPACITY> s_configFilter;
+static StaticJsonDocument<FILTER_JSON_CAPACITY> s_commandsFilter;
+static StaticJsonDocument<FILTER_JSON_CAPACITY> s_syncFilter;
+
+// --- Stan prywatny loop() ---
+static int      g_lastCommandId = 0;        // Ostatnie wykonane ID komendy (zapisywane we Flash)
+static uint32_t g_appliedConfigVersion = 0; // Wersja ostatnio zastosowanej konfiguracji (we Flash)
+
+static void backendTaskLoop(void* param);
+static void commandTaskLoop(void* param);
+static bool sendTelemetry(const EncodedSnapshot& snap, uint8_t fields);
+static bool syncWithBackend(const EncodedSnapshot& snap, uint8_t fields, bool& delivered);
+static EncodedSnapshot encodeSnapshot(const TelemetryRequest& req);
+static bool snapshotFieldsToSend(const EncodedSnapshot& snap, bool full, uint8_t& fields);
+static void stashSnapshot(const EncodedSnapshot& snap);
+static void uploadHistory();
+static void sendPendingEvent(bool forceSync);
+static void fetchConfiguration();
+static void pushLocalConfiguration();
+static int  fetchCommands(BackendSession& session, uint8_t waitSec, uint16_t timeoutMs);
+static void applyConfiguration(const BackendConfig& cfg);
+static void parseConfig(JsonObjectConst src, BackendConfig& cfg);
+static BackendConfig currentConfiguration();
+
+static void buildParserFilters() {
+    for (size_t i = 0; i < CONFIG_KEY_COUNT; i++) {
+        s_configFilter[CONFIG_KEYS[i]] = true;
+        s_syncFilter["config"][CONFIG_KEYS[i]] = true;
+    }
+
+    s_commandsFilter["items"][0]["id"] = true;
+    s_commandsFilter["items"][0]["type"] = true;
+    s_commandsFilter["items"][0]["payload"]["durationMs"] = true;
+
+    s_syncFilter["configVersion"] = true;
+    s_syncFilter["commands"][0]["id"] = true;
+    s_syncFilter["commands"][0]["type"] = true;
+    s_syncFilter["commands"][0]["payload"]["durationMs"] = true;
+}
 
 void backendTasksSetup() {
     g_lastCommandId = configGetLastCommandId();
+    s_fetchCursorId = g_lastCommandId;
+    g_appliedConfigVersion = configGetBackendConfigVersion();
+    s_knownConfigVersion = g_appliedConfigVersion;
     Serial.printf("[Backend] System start. Ostatnie ID komendy z Flash: %d\n", g_lastCommandId);
+
+    s_clientReady = backendClientSetup(FLORA_BACKEND_BASE_URL, FLORA_BACKEND_TOKEN);
+    backendClientSessionInit(s_netSession, "net");
+    backendClientSessionInit(s_cmdSession, "cmd");
+    buildParserFilters();
+    snprintf(s_telemetryPath, sizeof(s_telemetryPath), "/api/flora/%s/telemetry", FLORA_BACKEND_DEVICE_ID);
+    snprintf(s_configPath,    sizeof(s_configPath),    "/api/flora/%s/config",    FLORA_BACKEND_DEVICE_ID);
+    snprintf(s_commandsPath,  sizeof(s_commandsPath),  "/api/flora/%s/commands",  FLORA_BACKEND_DEVICE_ID);
+    snprintf(s_syncPath,      sizeof(s_syncPath),      "/api/flora/%s/sync",      FLORA_BACKEND_DEVICE_ID);
+    snprintf(s_historyPath,   sizeof(s_historyPath),   "/api/flora/%s/telemetry/batch", FLORA_BACKEND_DEVICE_ID);
+
+    s_telemetryQueue = xQueueCreate(1, sizeof(TelemetryRequest));
+    s_configQueue    = xQueueCreate(CONFIG_QUEUE_LENGTH, sizeof(BackendConfig));
+    s_commandQueue   = xQueueCreate(COMMAND_QUEUE_LENGTH, sizeof(BackendCommand));
+    s_eventQueue     = xQueueCreate(EVENT_QUEUE_LENGTH, sizeof(TelemetryRequest));
+    s_configPushQueue = xQueueCreate(1, sizeof(BackendConfig));
+    s_syncEvents     = xEventGroupCreate();
+    s_commandMutex   = xSemaphoreCreateMutex();
+}
+
+static void onWiFiGotIp(WiFiEvent_t event) {
+    (void)event;
+    if (s_netTask) xTaskNotifyGive(s_netTask);
+    if (s_cmdTask) xTaskNotifyGive(s_cmdTask);
+}
+
+void backendTasksStart() {
+    if (s_netTask != nullptr) return;
+    if (!s_clientReady) {
+        // Pomiary trafiają do historii RTC - nic nie przepada po poprawieniu adresu
+        Serial.println(F("[Backend] Zadanie sieciowe nieaktywne - popraw FLORA_BACKEND_BASE_URL w secrets.h."));
+        return;
+    }
+    if (!s_telemetryQueue || !s_configQueue || !s_commandQueue || !s_eventQueue || !s_configPushQueue ||
+        !s_syncEvents || !s_commandMutex) {
+        Serial.println(F("[Backend] BŁĄD: Nie udało się utworzyć kolejek - zadanie sieciowe nieaktywne."));
+        return;
+    }
+
+    BaseType_t ok = xTaskCreatePinnedToCore(
+        backendTaskLoop, "backend", NET_TASK_STACK_SIZE, nullptr,
+        NET_TASK_PRIORITY, &s_netTask, NET_TASK_CORE);
+
+    if (ok != pdPASS) {
+        s_netTask = nullptr;
+        Serial.println(F("[Backend] BŁĄD: Nie udało się uruchomić zadania sieciowego!"));
+    } else {
+        Serial.printf("[Backend] Zadanie sieciowe uruchomione na rdzeniu %d.\n", NET_TASK_CORE);
+        // Połączenie zestawiane jest w tle od startu - budzimy zadanie, gdy tylko jest IP
+        WiFi.onEvent(onWiFiGotIp, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    }
 }
 
-void fetchAndApplyConfiguration() {
-    // --- STOPER (Pobieranie konfiguracji co 2 sekundy) ---
-    static unsigned long lastConfigCheckTime = 0;
-    const unsigned long CONFIG_CHECK_INTERVAL_MS = 2000; 
+void backendTasksStartCommandChannel() {
+    if (s_cmdTask != nullptr || s_netTask == nullptr) return;
 
-    if (lastConfigCheckTime != 0 && (millis() - lastConfigCheckTime < CONFIG_CHECK_INTERVAL_MS)) {
-        return; // Za wcześnie, wracamy do pętli
+    BaseType_t ok = xTaskCreatePinnedToCore(
+        commandTaskLoop, "backend_cmd", CMD_TASK_STACK_SIZE, nullptr,
+        NET_TASK_PRIORITY, &s_cmdTask, NET_TASK_CORE);
+
+    if (ok != pdPASS) {
+        s_cmdTask = nullptr;
+        Serial.println(F("[Backend] BŁĄD: Nie udało się uruchomić kanału komend!"));
+    } else {
+        Serial.println(F("[Backend] Kanał komend (long-poll) uruchomiony."));
     }
-    lastConfigCheckTime = millis();
-    // -----------------------------------------------------
+}
 
-    if (WiFi.status() != WL_CONNECTED) return;
+void backendQueueTelemetry(const SensorData& data, bool pumpRunning, bool alarmActive) {
+    if (!s_telemetryQueue) return;
 
-    HTTPClient http;
-    String url = String(FLORA_BACKEND_BASE_URL) + "/api/flora/" + FLORA_BACKEND_DEVICE_ID + "/config";
-    
-    http.begin(url);
-    http.setTimeout(2000);
-    http.addHeader("Authorization", String("Bearer ") + FLORA_BACKEND_TOKEN);
+    TelemetryRequest req;
+    req.data = data;
+    req.pumpRunning = pumpRunning;
+    req.alarmActive = alarmActive;
+    const time_t now = time(nullptr);
+    req.measuredAt = now >= MIN_VALID_UNIX_TIME ? (uint32_t)now : 0;
+    req.event = BACKEND_EVENT_NONE;
 
-    int httpCode = http.GET();
-    if (httpCode == 200) {
-        String payload = http.getString();
-        DynamicJsonDocument doc(2048); 
-        DeserializationError error = deserializeJson(doc, payload);
-
-        if (!error) {
-            // 1. Tryb ciągły
-            if (doc.containsKey("continuousMode")) {
-                bool serverVal = doc["continuousMode"].as<bool>();
-                if (serverVal != configIsContinuousMode()) {
-                    configSetContinuousMode(serverVal);
-                    Serial.printf("[Backend] -> Zmieniono Tryb Ciągły na: %s\n", serverVal ? "TAK" : "NIE");
-                }
-            }
+    // Niewysłany starszy snapshot (np. brak WiFi) nie przepada - trafia do historii RTC
+    TelemetryRequest pending;
+    if (xQueueReceive(s_telemetryQueue, &pending, 0) == pdTRUE) {
+        stashSnapshot(encodeSnapshot(pending));
+    }
+    xQueueOverwrite(s_telemetryQueue, &req);
+    if (s_netTask) xTaskNotifyGive(s_netTask);
+}
 
-            // 2. Czas pracy pompy 
-            if (doc.containsKey("pumpDurationMs")) {
-                uint32_t serverVal = doc["pumpDurationMs"].as<uint32_t>();
-                if (serverVal != configGetPumpRunMillis()) {
-                    configSetPumpRunMillis(serverVal);
-                    Serial.printf("[Backend] -> Zmieniono Czas Pracy Pompy na: %lu ms\n", serverVal);
-                }
-            }
+void backendQueueEvent(BackendEvent event, const SensorData& data, bool pumpRunning, bool alarmActive) {
+    if (!s_eventQueue) return;
 
-            // 3. Próg wilgotności dla uruchomienia pompy
-            if (doc.containsKey("soilThresholdPercent")) {
-                int serverVal = doc["soilThresholdPercent"].as<int>();
-                if (serverVal != configGetSoilThresholdPercent()) {
-                    configSetSoilThresholdPercent(serverVal);
-                    Serial.printf("[Backend] -> Zmieniono Próg Podlewania na: %d %%\n", serverVal);
-                }
-            }
+    TelemetryRequest req;
+    req.data = data;
+    req.pumpRunning = pumpRunning;
+    req.alarmActive = alarmActive;
+    const time_t now = time(nullptr);
+    req.measuredAt = now >= MIN_VALID_UNIX_TIME ? (uint32_t)now : 0;
+    req.event = event;
 
-            // 4. Próg alarmu niskiej baterii
-            if (doc.containsKey("lowBatteryMilliVolts")) {
-                int serverVal = doc["lowBatteryMilliVolts"].as<int>();
-                if (serverVal != configGetLowBatteryMilliVolts()) {
-                    configSetLowBatteryMilliVolts(serverVal);
-                    Serial.printf("[Backend] -> Zmieniono Próg Baterii na: %d mV\n", serverVal);
-                }
-            }
+    // Czekający rutynowy snapshot niesie ten sam (najnowszy) pomiar ze starym stanem pompy/alarmu -
+    // wysłany po zdarzeniu cofnąłby stan na serwerze
+    xQueueReset(s_telemetryQueue);
 
-            // 5. Próg alarmu suchej gleby
-            if (doc.containsKey("lowSoilPercent")) {
-                int serverVal = doc["lowSoilPercent"].as<int>();
-                if (serverVal != configGetLowSoilPercent()) {
-                    configSetLowSoilPercent(serverVal);
-                    Serial.printf("[Backend] -> Zmieniono Próg Alarmu Gleby na: %d %%\n", serverVal);
-                }
-            }
+    // Pełna kolejka (długo bez sieci): najstarsze zdarzenie ustępuje miejsca i czeka w historii RTC
+    TelemetryRequest oldest;
+    if (uxQueueSpacesAvailable(s_eventQueue) == 0 && xQueueReceive(s_eventQueue, &oldest, 0) == pdTRUE) {
+        stashSnapshot(encodeSnapshot(oldest));
+    }
+    xQueueSendToBack(s_eventQueue, &req, 0);
+    if (s_netTask) xTaskNotifyGive(s_netTask);
+}
 
-            // 6. Próg detekcji wody w zbiorniku
-            if (doc.containsKey("waterLevelThreshold")) {
-                uint16_t serverVal = doc["waterLevelThreshold"].as<uint16_t>();
-                if (serverVal != configGetWaterLevelThreshold()) {
-                    configSetWaterLevelThreshold(serverVal);
-                    Serial.printf("[Backend] -> Zmieniono Próg Wykrycia Wody na: %u ADC\n", serverVal);
-                }
+void backendTasksStashPendingTelemetry() {
+    TelemetryRequest req;
+    while (s_eventQueue && xQueueReceive(s_eventQueue, &req, 0) == pdTRUE) {
+        stashSnapshot(encodeSnapshot(req));
+    }
+    if (s_telemetryQueue && xQueueReceive(s_telemetryQueue, &req, 0) == pdTRUE) {
+        stashSnapshot(encodeSnapshot(req));
+    }
+}
+
+void backendTasksSetListenWindow(bool enabled) {
+    s_listenWindow = enabled;
+}
+
+bool backendTasksWaitForSync(uint32_t timeoutMs) {
+    if (!s_netTask) return false;
+
+    xEventGroupClearBits(s_syncEvents, SYNC_DONE_BIT);
+    s_syncRequested = true;
+    xTaskNotifyGive(s_netTask);
+
+    EventBits_t bits = xEventGroupWaitBits(s_syncEvents, SYNC_DONE_BIT, pdTRUE, pdTRUE, pdMS_TO_TICKS(timeoutMs));
+    if (!(bits & SYNC_DONE_BIT)) {
+        Serial.printf("[Backend] Synchronizacja nie zakończyła się w %lu ms.\n", (unsigned long)timeoutMs);
+        return false;
+    }
+    return true;
+}
+
+bool backendTasksHasPending() {
+    if (!s_configQueue || !s_commandQueue) return false;
+    return uxQueueMessagesWaiting(s_configQueue) > 0 || uxQueueMessagesWaiting(s_commandQueue) > 0;
+}
+
+bool backendTasksRunPump(uint32_t durationMs, int currentWaterLevel) {
+    if (currentWaterLevel <= 0) {
+        Serial.println("[Backend] Odrzucono komendę z aplikacji - BRAK WODY!");
+        return false;
+    }
+    Serial.printf("[Backend] Wykryto komendę PUMP! Czas: %lu ms\n", (unsigned long)durationMs);
+    pumpControlManualTurnOn(durationMs);
+    return true;
+}
+
+bool backendTasksApplyConfigJson(const char* json, size_t length) {
+    StaticJsonDocument<CONFIG_JSON_CAPACITY> doc;
+    const DeserializationError error = deserializeJson(doc, json, length, DeserializationOption::Filter(s_configFilter));
+    if (error || !doc.is<JsonObject>()) return false;
+
+    BackendConfig cfg;
+    parseConfig(doc.as<JsonObjectConst>(), cfg);
+    if (cfg.present == 0) return false;
+    applyConfiguration(cfg);
+
+    // Backend jest źródłem prawdy - zmiana idzie do niego (PUT /config), inaczej kolejna zmiana
+    // w aplikacji po cichu by ją cofnęła. Skrzynka: czeka tylko najnowszy stan.
+    if (s_configPushQueue) {
+        const BackendConfig full = currentConfiguration();
+        xQueueOverwrite(s_configPushQueue, &full);
+        if (s_netTask) xTaskNotifyGive(s_netTask);
+    }
+    return true;
+}
+
+bool backendTasksProcess(int currentWaterLevel) {
+    if (!s_configQueue || !s_commandQueue) return false;
+
+    bool processed = false;
+    BackendConfig cfg;
+    while (xQueueReceive(s_configQueue, &cfg, 0) == pdTRUE) {
+        applyConfiguration(cfg);
+        processed = true;
+    }
+
+    BackendCommand cmd;
+    bool pumpTriggeredInThisBatch = false; // Tarcza antyspamowa!
+
+    while (xQueueReceive(s_commandQueue, &cmd, 0) == pdTRUE) {
+        processed = true;
+        if (cmd.type == BACKEND_CMD_PUMP) {
+            if (pumpTriggeredInThisBatch) {
+                Serial.printf("[Backend] Zignorowano powieloną komendę PUMP (ID: %d) - antyspam!\n", cmd.id);
+            } else if (backendTasksRunPump(cmd.durationMs, currentWaterLevel)) {
+                pumpTriggeredInThisBatch = true;
             }
+        }
 
-            // 7. Dźwięk alarmu
-            if (doc.containsKey("alarmSoundEnabled")) {
-                bool serverVal = doc["alarmSoundEnabled"].as<bool>();
-                if (serverVal != configIsAlarmSoundEnabled()) {
-                    configSetAlarmSoundEnabled(serverVal);
-                    Serial.printf("[Backend] -> Zmieniono Dźwięk Alarmu na: %s\n", serverVal ? "Włączony" : "Wyłączony");
-                }
+        if (cmd.id > g_lastCommandId) {
+            g_lastCommandId = cmd.id;
+            configSetLastCommandId(g_lastCommandId);
+        }
+    }
+    return processed;
+}
+
+// =============================================================
+//  Zadanie sieciowe (rdzeń 0)
+// =============================================================
+
+// ±10% losowo - urządzenia uruchomione razem (np. po zaniku prądu) rozjeżdżają się w czasie
+static uint32_t withJitter(uint32_t intervalMs) {
+    const uint32_t span = intervalMs / 5;
+    if (span == 0) return intervalMs;
+    return intervalMs - span / 2 + esp_random() % span;
+}
+
+// Przyjmuje czas serwera (nagłówek Date - zegar bez NTP przy każdym połączeniu) oraz interwał
+// zalecany przez serwer (szybko, gdy ktoś ma otwartą aplikację; minuty w spoczynku)
+static void applyServerHints(const BackendSession& session) {
+    powerManagerApplyServerTime(backendClientLastServerTime(session));
+
+    uint32_t hintMs = backendClientLastPollHintMs(session);
+    if (hintMs == 0) return;
+    hintMs = constrain(hintMs, MIN_POLL_INTERVAL_MS, MAX_POLL_INTERVAL_MS);
+    if (hintMs == s_pollIntervalMs) return;
+
+    const bool faster = hintMs < s_pollIntervalMs;
+    s_pollIntervalMs = hintMs;
+    Serial.printf("[Backend] Serwer zaleca odpytywanie co %lu ms.\n", (unsigned long)hintMs);
+
+    // Ktoś właśnie otworzył aplikację - nie czekamy do końca długiego interwału
+    if (faster) {
+        s_configPollDelayMs = withJitter(hintMs);
+        if (s_netTask && xTaskGetCurrentTaskHandle() != s_netTask) xTaskNotifyGive(s_netTask);
+    }
+}
+
+static void backendTaskLoop(void* param) {
+    (void)param;
+
+    for (;;) {
+        // Śpimy do najbliższego terminu odpytywania albo do powiadomienia z loop()
+        unsigned long now = millis();
+        unsigned long sinceConfig = now - s_lastConfigCheckTime;
+        unsigned long waitMs = 0;
+        if (s_firstPollDone && sinceConfig < s_configPollDelayMs) {
+            waitMs = s_configPollDelayMs - sinceConfig;
+        }
+        // Zdarzenie czeka najwyżej do swojej kolejnej próby
+        if (uxQueueMessagesWaiting(s_eventQueue) > 0) {
+            const long untilRetry = (long)(s_eventRetryAt - now);
+            waitMs = min(waitMs, (unsigned long)max(untilRetry, 0L));
+        }
+        if (waitMs > 0) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs));
+        }
+
+        const bool forceSync = s_syncRequested;
+        s_syncRequested = false;
+
+        if (WiFi.status() != WL_CONNECTED) {
+            if (s_wifiWasConnected) {
+                backendClientReset(s_netSession);  // Stare gniazdo i IP mogą być nieaktualne po ponownym połączeniu
+                s_wifiWasConnected = false;
             }
+            if (forceSync) xEventGroupSetBits(s_syncEvents, SYNC_DONE_BIT);
+            // Bez WiFi nie ma czego robić - sprawdzamy ponownie za chwilę
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_CHECK_INTERVAL_MS));
+            continue;
+        }
+        s_wifiWasConnected = true;
 
-            // 8. Kalibracja czujnika wilgotności - SUCHO
-            if (doc.containsKey("soilDryAdc")) {
-                int serverVal = doc["soilDryAdc"].as<int>();
-                if (serverVal != configGetSoilDryADC()) {
-                    configSetSoilDryADC(serverVal);
-                    Serial.printf("[Backend] -> Zmieniono Kalibrację SUCHO na: %d ADC\n", serverVal);
-                }
+        // Okno nasłuchu: jedno krótkie zapytanie o komendy; telemetria i konfiguracja czekają
+        // na pełne wybudzenie (loop() kończy okno, gdy przyszła komenda)
+        if (s_listenWindow) {
+            if (forceSync) {
+                fetchCommands(s_netSession, 0, 2000);
+                xEventGroupSetBits(s_syncEvents, SYNC_DONE_BIT);
             }
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        // Pas priorytetowy: alarm i pompa nie czekają na termin odpytywania ani na rutynowe dane
+        sendPendingEvent(forceSync);
+        pushLocalConfiguration();
+
+        // Pas rutynowy: pomiary czekają (i łączą się w kolejce) do terminu odpytywania konfiguracji
+        now = millis();
+        if (!forceSync && s_firstPollDone && now - s_lastConfigCheckTime < s_configPollDelayMs) {
+            continue;
+        }
 
-            // 9. Kalibracja czujnika wilgotności - MOKRO
-            if (doc.containsKey("soilWetAdc")) {
-                int serverVal = doc["soilWetAdc"].as<int>();
-                if (serverVal != configGetSoilWetADC()) {
-                    configSetSoilWetADC(serverVal);
-                    Serial.printf("[Backend] -> Zmieniono Kalibrację MOKRO na: %d ADC\n", serverVal);
+        // Słabe łącze: rutynowa wysyłka (historia, snapshot, konfiguracja) czeka na lepsze warunki.
+        // Snapshot zostaje w kolejce, a przed Deep Sleep trafia do historii RTC.
+        if (linkQualityShouldDefer()) {
+            s_lastConfigCheckTime = millis();
+            s_configPollDelayMs = withJitter(max(LINK_DEFER_RETRY_MS, (uint32_t)s_pollIntervalMs));
+            s_firstPollDone = true;
+            if (forceSync) xEventGroupSetBits(s_syncEvents, SYNC_DONE_BIT);
+            continue;
+        }
+
+        // Najpierw zaległe pomiary z historii - bieżący snapshot będzie po nich najnowszy
+        uploadHistory();
+
+        // Jest snapshot do wysłania -> jedna wymiana /sync zamiast trzech zapytań
+        TelemetryRequest req;
+        if (xQueueReceive(s_telemetryQueue, &req, 0) == pdTRUE) {
+            const EncodedSnapshot snap = encodeSnapshot(req);
+            uint8_t fields;
+            bool delivered = false;
+            if (!snapshotFieldsToSend(snap, forceSync, fields)) {
+                Serial.println(F("[Backend] Odczyty bez istotnych zmian - pomijam wysyłkę snapshotu."));
+            } else if (!backendHealthAllow(BACKEND_EP_SYNC)) {
+                // Obwód otwarty - snapshot wraca do kolejki; jeśli loop() zdążył wstawić nowszy, idzie do historii
+                if (xQueueSendToFront(s_telemetryQueue, &req, 0) != pdTRUE) {
+                    stashSnapshot(snap);
+                }
+            } else {
+                const bool synced = syncWithBackend(snap, fields, delivered);
+                if (!delivered) {
+                    stashSnapshot(snap);   // Pomiar wróci w paczce historii
+                }
+                if (synced) {
+                    s_lastConfigCheckTime = millis();
+                    s_configPollDelayMs = withJitter(s_pollIntervalMs);
+                    s_firstPollDone = true;
+                    if (forceSync) xEventGroupSetBits(s_syncEvents, SYNC_DONE_BIT);
+                    continue;
                 }
             }
+        }
 
-            // 10. Moc pompy (Z procentów 0-100 na PWM 0-255)
-            if (doc.containsKey("pumpPowerPercent")) {
-                int serverVal = doc["pumpPowerPercent"].as<int>();
-                uint8_t dutyCycle = (uint8_t)((serverVal * 255) / 100);
-                if (dutyCycle != configGetPumpDutyCycle()) {
-                    configSetPumpDutyCycle(dutyCycle);
-                    Serial.printf("[Backend] -> Zmieniono Moc Pompy na: %d%% (Duty: %d)\n", serverVal, dutyCycle);
-                }
+        s_lastConfigCheckTime = millis();
+        fetchConfiguration();
+        s_configPollDelayMs = withJitter(s_pollIntervalMs);
+
+        // Na bieżąco komendy odbiera kanał long-poll; tu tylko przy synchronizacji (np. po wybudzeniu)
+        if (forceSync || !s_firstPollDone) {
+            fetchCommands(s_netSession, 0, 2000);
+        }
+
+        s_firstPollDone = true;
+        if (forceSync) xEventGroupSetBits(s_syncEvents, SYNC_DONE_BIT);
+    }
+}
+
+// Kanał komend: zapytanie wisi na serwerze, dopóki nie pojawi się komenda albo nie minie
+// LONG_POLL_WAIT_S - opóźnienie komendy to czas jednej odpowiedzi, a bez komend ruch jest znikomy
+static void commandTaskLoop(void* param) {
+    (void)param;
+    bool wifiWasConnected = false;
+
+    for (;;) {
+        if (WiFi.status() != WL_CONNECTED) {
+            if (wifiWasConnected) {
+                backendClientReset(s_cmdSession);
+                wifiWasConnected = false;
             }
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(COMMAND_CHECK_INTERVAL_MS));
+            continue;
+        }
+        wifiWasConnected = true;
 
-            // 11 i 12. Godzina i Minuta pomiaru (Używamy jednej łączonej funkcji settera)
-            if (doc.containsKey("measurementHour") && doc.containsKey("measurementMinute")) {
-                int serverHour = doc["measurementHour"].as<int>();
-                int serverMinute = doc["measurementMinute"].as<int>();
-                
-                if (serverHour != configGetMeasurementHour() || serverMinute != configGetMeasurementMinute()) {
-                    if (configSetMeasurementTime(serverHour, serverMinute)) {
-                        Serial.printf("[Backend] -> Zmieniono Czas Pomiaru na: %02d:%02d\n", serverHour, serverMinute);
-                    }
-                }
+        const unsigned long started = millis();
+        const int received = fetchCommands(s_cmdSession, LONG_POLL_WAIT_S, LONG_POLL_TIMEOUT_MS);
+
+        // Błąd albo natychmiastowa pusta odpowiedź - nie wolno kręcić się w pętli zapytań
+        if (received < 0 || (received == 0 && millis() - started < LONG_POLL_MIN_HOLD_MS)) {
+            const uint32_t pauseMs = max(withJitter(COMMAND_CHECK_INTERVAL_MS),
+                                         backendHealthRetryInMs(BACKEND_EP_COMMANDS));
+            vTaskDelay(pdMS_TO_TICKS(pauseMs));
+        }
+    }
+}
+
+static EncodedSnapshot encodeSnapshot(const TelemetryRequest& req) {
+    const SensorData& data = req.data;
+    const bool dhtValid = !isnan(data.temperature) && !isnan(data.humidity);
+
+    EncodedSnapshot snap;
+    snap.flags = (req.pumpRunning ? SNAPSHOT_FLAG_PUMP_RUNNING : 0) |
+                 (req.alarmActive ? SNAPSHOT_FLAG_ALARM_ACTIVE : 0) |
+                 (dhtValid ? SNAPSHOT_FLAG_DHT_VALID : 0);
+    snap.soilMoisturePercent = (int8_t)constrain(data.soilMoisture, -1, 127);
+    snap.waterLevel = (int8_t)constrain(data.waterLevel, -1, 127);
+    snap.batteryMilliVolts = data.batteryVoltage > 0 ? (uint16_t)lroundf(min(data.batteryVoltage, 65.0f) * 1000.0f) : 0;
+    snap.temperatureCentiC = dhtValid ? (int16_t)lroundf(constrain(data.temperature, -300.0f, 300.0f) * 100.0f) : 0;
+    snap.humidityCentiPercent = dhtValid ? (uint16_t)lroundf(constrain(data.humidity, 0.0f, 100.0f) * 100.0f) : 0;
+    snap.backendFailures = (uint16_t)min(backendHealthTotalFailures(), (uint32_t)UINT16_MAX);
+    snap.backendBlockedMs = backendHealthTotalBlockedMs();
+    const LinkMetrics link = linkQualityMetrics();
+    snap.wifiRssi = link.rssi;
+    snap.linkRttMs = link.rttMs;
+    snap.uploadDeferrals = link.deferrals;
+    snap.measuredAt = req.measuredAt;
+    return snap;
+}
+
+static bool outsideDeadband(int current, int acked, int deadband) {
+    return abs(current - acked) > deadband;
+}
+
+/**
+ * @brief Wybiera pola do wysłania: te, które wyszły poza martwą strefę względem ostatnio
+ * potwierdzonego snapshotu, albo wszystkie (brak bazy, heartbeat, wymuszona synchronizacja)
+ * @param fields [out] Maska SNAPSHOT_FIELD_* (0 = same flagi pompy/alarmu)
+ * @return false jeśli nic się istotnie nie zmieniło i snapshot można pominąć
+ */
+static bool snapshotFieldsToSend(const EncodedSnapshot& snap, bool full, uint8_t& fields) {
+    if (full || !s_hasAckedSnapshot || millis() - s_lastFullSnapshotTime >= TELEMETRY_HEARTBEAT_MS) {
+        fields = SNAPSHOT_FIELD_ALL;
+        return true;
+    }
+
+    const EncodedSnapshot& acked = s_ackedSnapshot;
+    fields = 0;
+    if (outsideDeadband(snap.soilMoisturePercent, acked.soilMoisturePercent, DEADBAND_SOIL_PERCENT)) {
+        fields |= SNAPSHOT_FIELD_SOIL;
+    }
+    if (snap.waterLevel != acked.waterLevel) {
+        fields |= SNAPSHOT_FIELD_WATER;
+    }
+    if (outsideDeadband(snap.batteryMilliVolts, acked.batteryMilliVolts, DEADBAND_BATTERY_MV)) {
+        fields |= SNAPSHOT_FIELD_BATTERY;
+    }
+    // Utrata/odzyskanie DHT zawsze wysyłamy obie wartości (0 = brak odczytu)
+    const bool dhtChanged = (snap.flags ^ acked.flags) & SNAPSHOT_FLAG_DHT_VALID;
+    if (dhtChanged || outsideDeadband(snap.temperatureCentiC, acked.temperatureCentiC, DEADBAND_TEMPERATURE_CENTI)) {
+        fields |= SNAPSHOT_FIELD_TEMPERATURE;
+    }
+    if (dhtChanged || outsideDeadband(snap.humidityCentiPercent, acked.humidityCentiPercent, DEADBAND_HUMIDITY_CENTI)) {
+        fields |= SNAPSHOT_FIELD_HUMIDITY;
+    }
+    if (snap.backendFailures != acked.backendFailures) {
+        fields |= SNAPSHOT_FIELD_HEALTH;
+    }
+    if (snap.uploadDeferrals != acked.uploadDeferrals ||
+        outsideDeadband(snap.wifiRssi, acked.wifiRssi, DEADBAND_RSSI_DBM) ||
+        outsideDeadband(snap.linkRttMs, acked.linkRttMs, DEADBAND_RTT_MS)) {
+        fields |= SNAPSHOT_FIELD_LINK;
+    }
+
+    // Sama zmiana stanu pompy/alarmu też jest warta wysłania (snapshot z samymi flagami)
+    return fields != 0 || snap.flags != acked.flags;
+}
+
+// Serwer potwierdził snapshot - wysłane pola stają się nową bazą martwych stref
+static void ackSnapshot(const EncodedSnapshot& snap, uint8_t fields) {
+    EncodedSnapshot& acked = s_ackedSnapshot;
+    acked.flags = snap.flags;
+    if (fields & SNAPSHOT_FIELD_SOIL)        acked.soilMoisturePercent = snap.soilMoisturePercent;
+    if (fields & SNAPSHOT_FIELD_WATER)       acked.waterLevel = snap.waterLevel;
+    if (fields & SNAPSHOT_FIELD_BATTERY)     acked.batteryMilliVolts = snap.batteryMilliVolts;
+    if (fields & SNAPSHOT_FIELD_TEMPERATURE) acked.temperatureCentiC = snap.temperatureCentiC;
+    if (fields & SNAPSHOT_FIELD_HUMIDITY)    acked.humidityCentiPercent = snap.humidityCentiPercent;
+    if (fields & SNAPSHOT_FIELD_HEALTH) {
+        acked.backendFailures = snap.backendFailures;
+        acked.backendBlockedMs = snap.backendBlockedMs;
+    }
+    if (fields & SNAPSHOT_FIELD_LINK) {
+        acked.wifiRssi = snap.wifiRssi;
+        acked.linkRttMs = snap.linkRttMs;
+        acked.uploadDeferrals = snap.uploadDeferrals;
+    }
+    if (fields == SNAPSHOT_FIELD_ALL) {
+        s_hasAckedSnapshot = true;
+        s_lastFullSnapshotTime = millis();
+    }
+}
+
+// Dopisuje sformatowany fragment do bufora; false = bufor za mały
+static bool appendf(char* buf, size_t size, size_t& used, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf + used, size - used, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= size - used) return false;
+    used += n;
+    return true;
+}
+
+// Dopisuje obiekt JSON snapshotu z wybranymi polami (wspólne dla /sync i historii)
+static bool appendSnapshotJson(const EncodedSnapshot& snap, uint8_t fields, char* payload, size_t size, size_t& used) {
+    bool ok = appendf(payload, size, used, "{\"pumpRunning\":%s,\"alarmActive\":%s",
+                      (snap.flags & SNAPSHOT_FLAG_PUMP_RUNNING) ? "true" : "false",
+                      (snap.flags & SNAPSHOT_FLAG_ALARM_ACTIVE) ? "true" : "false");
+    if (fields & SNAPSHOT_FIELD_SOIL) {
+        ok = ok && appendf(payload, size, used, ",\"soilMoisturePercent\":%d", snap.soilMoisturePercent);
+    }
+    if (fields & SNAPSHOT_FIELD_WATER) {
+        ok = ok && appendf(payload, size, used, ",\"waterLevel\":%d", snap.waterLevel);
+    }
+    if (fields & SNAPSHOT_FIELD_BATTERY) {
+        ok = ok && appendf(payload, size, used, ",\"batteryVoltage\":%u.%03u",
+                           snap.batteryMilliVolts / 1000, snap.batteryMilliVolts % 1000);
+    }
+    if (fields & SNAPSHOT_FIELD_TEMPERATURE) {
+        const int t = snap.temperatureCentiC;
+        ok = ok && appendf(payload, size, used, ",\"temperature\":%s%d.%02d", t < 0 ? "-" : "", abs(t) / 100, abs(t) % 100);
+    }
+    if (fields & SNAPSHOT_FIELD_HUMIDITY) {
+        ok = ok && appendf(payload, size, used, ",\"humidity\":%u.%02u",
+                           snap.humidityCentiPercent / 100, snap.humidityCentiPercent % 100);
+    }
+    if (fields & SNAPSHOT_FIELD_HEALTH) {
+        ok = ok && appendf(payload, size, used, ",\"backendFailures\":%u,\"backendBlockedMs\":%lu",
+                           snap.backendFailures, (unsigned long)snap.backendBlockedMs);
+    }
+    if (fields & SNAPSHOT_FIELD_LINK) {
+        ok = ok && appendf(payload, size, used, ",\"wifiRssi\":%d,\"linkRttMs\":%u,\"uploadDeferrals\":%u",
+                           snap.wifiRssi, snap.linkRttMs, snap.uploadDeferrals);
+    }
+    return ok && appendf(payload, size, used, "}");
+}
+
+// Składa snapshot JSON z wybranymi polami (serwer scala go z poprzednim stanem)
+static size_t buildSnapshotJson(const EncodedSnapshot& snap, uint8_t fields, char* payload, size_t size) {
+    size_t used = 0;
+    const bool ok = appendf(payload, size, used, "{\"snapshot\":") &&
+                    appendSnapshotJson(snap, fields, payload, size, used) &&
+                    appendf(payload, size, used, "}");
+    return ok ? used : 0;
+}
+
+template <typename T>
+static size_t putField(uint8_t* dst, T value) {
+    memcpy(dst, &value, sizeof(value));
+    return sizeof(value);
+}
+
+// Składa binarny snapshot z wybranymi polami - bez formatowania liczb
+static size_t buildSnapshotBinary(const EncodedSnapshot& snap, uint8_t fields, uint8_t* payload, size_t size) {
+    if (size < BINARY_SNAPSHOT_MAX_SIZE) return 0;
+
+    size_t n = 0;
+    payload[n++] = TELEMETRY_BINARY_VERSION;
+    payload[n++] = snap.flags;
+    payload[n++] = fields;
+    if (fields & SNAPSHOT_FIELD_SOIL)        n += putField(payload + n, snap.soilMoisturePercent);
+    if (fields & SNAPSHOT_FIELD_WATER)       n += putField(payload + n, snap.waterLevel);
+    if (fields & SNAPSHOT_FIELD_BATTERY)     n += putField(payload + n, snap.batteryMilliVolts);
+    if (fields & SNAPSHOT_FIELD_TEMPERATURE) n += putField(payload + n, snap.temperatureCentiC);
+    if (fields & SNAPSHOT_FIELD_HUMIDITY)    n += putField(payload + n, snap.humidityCentiPercent);
+    if (fields & SNAPSHOT_FIELD_HEALTH) {
+        n += putField(payload + n, snap.backendFailures);
+        n += putField(payload + n, snap.backendBlockedMs);
+    }
+    if (fields & SNAPSHOT_FIELD_LINK) {
+        n += putField(payload + n, snap.wifiRssi);
+        n += putField(payload + n, snap.linkRttMs);
+        n += putField(payload + n, snap.uploadDeferrals);
+    }
+    return n;
+}
+
+// Snapshot w bieżącym formacie (binarny albo JSON)
+// @return Długość treści (0 = błąd), contentType ustawiany na odpowiedni typ
+static size_t buildSnapshot(const EncodedSnapshot& snap, uint8_t fields, uint8_t* payload, size_t size,
+                            const char*& contentType) {
+    if (s_binaryTelemetry) {
+        contentType = TELEMETRY_BINARY_TYPE;
+        return buildSnapshotBinary(snap, fields, payload, size);
+    }
+    contentType = "application/json";
+    return buildSnapshotJson(snap, fields, (char*)payload, size);
+}
+
+// --- Historia w pamięci RTC ---
+
+static void stashSnapshot(const EncodedSnapshot& snap) {
+    TelemetryRecord record;
+    record.seq = 0;
+    record.measuredAt = snap.measuredAt;
+    record.batteryMilliVolts = snap.batteryMilliVolts;
+    record.temperatureCentiC = snap.temperatureCentiC;
+    record.humidityCentiPercent = snap.humidityCentiPercent;
+    record.soilMoisturePercent = snap.soilMoisturePercent;
+    record.waterLevel = snap.waterLevel;
+    record.flags = snap.flags;
+    telemetryHistoryPush(record);
+}
+
+static EncodedSnapshot snapshotFromRecord(const TelemetryRecord& record) {
+    EncodedSnapshot snap = {};
+    snap.flags = record.flags;
+    snap.soilMoisturePercent = record.soilMoisturePercent;
+    snap.waterLevel = record.waterLevel;
+    snap.batteryMilliVolts = record.batteryMilliVolts;
+    snap.temperatureCentiC = record.temperatureCentiC;
+    snap.humidityCentiPercent = record.humidityCentiPercent;
+    snap.measuredAt = record.measuredAt;
+    return snap;
+}
+
+/**
+ * @brief Składa paczkę historii w bieżącym formacie - tyle najstarszych rekordów, ile się zmieści
+ * @param sent [out] Liczba rekordów w paczce (0 = błąd)
+ * @return Długość treści
+ */
+static size_t buildHistoryBatch(const TelemetryRecord* records, size_t count, uint8_t* payload, size_t size,
+                                const char*& contentType, size_t& sent) {
+    sent = 0;
+    if (s_binaryTelemetry) {
+        contentType = TELEMETRY_BINARY_TYPE;
+        count = min(count, min((size_t)UINT8_MAX, (size - 2) / HISTORY_BINARY_RECORD_SIZE));
+        size_t n = 0;
+        payload[n++] = HISTORY_BINARY_VERSION;
+        payload[n++] = (uint8_t)count;
+        for (size_t i = 0; i < count; i++) {
+            const TelemetryRecord& rec = records[i];
+            n += putField(payload + n, rec.measuredAt);
+            n += putField(payload + n, rec.flags);
+            n += putField(payload + n, rec.soilMoisturePercent);
+            n += putField(payload + n, rec.waterLevel);
+            n += putField(payload + n, rec.batteryMilliVolts);
+            n += putField(payload + n, rec.temperatureCentiC);
+            n += putField(payload + n, rec.humidityCentiPercent);
+        }
+        sent = count;
+        return n;
+    }
+
+    contentType = "application/json";
+    char* json = (char*)payload;
+    size_t used = 0;
+    if (!appendf(json, size, used, "{\"records\":[")) return 0;
+    for (size_t i = 0; i < count; i++) {
+        const size_t before = used;
+        const bool ok = appendf(json, size, used, "%s{\"measuredAt\":%lu,\"snapshot\":", i ? "," : "",
+                                (unsigned long)records[i].measuredAt) &&
+                        appendSnapshotJson(snapshotFromRecord(records[i]), HISTORY_RECORD_FIELDS, json, size, used) &&
+                        appendf(json, size, used, "}");
+        // Zostawiamy miejsce na zamknięcie "]}" - reszta pójdzie w następnej porcji
+        if (!ok || size - used < 3) {
+            used = before;
+            break;
+        }
+        sent++;
+    }
+    if (sent == 0 || !appendf(json, size, used, "]}")) {
+        sent = 0;
+        return 0;
+    }
+    return used;
+}
+
+// Serwer nie zna formatu binarnego (415) albo go nie przyjął (400/422) - od teraz JSON
+static bool rejectBinaryTelemetry(int httpCode) {
+    if (!s_binaryTelemetry || (httpCode != 400 && httpCode != 415 && httpCode != 422)) return false;
+    s_binaryTelemetry = false;
+    Serial.printf("[Backend] Serwer odrzucił binarny snapshot (HTTP %d) - przechodzę na JSON.\n", httpCode);
+    return true;
+}
+
+// Przepisuje pola obecne w JSON do BackendConfig (brakujące pola zostają nietknięte w loop())
+static void parseConfig(JsonObjectConst src, BackendConfig& cfg) {
+    if (src.containsKey("continuousMode")) {
+        cfg.continuousMode = src["continuousMode"].as<bool>();
+        cfg.present |= CFG_CONTINUOUS_MODE;
+    }
+    if (src.containsKey("pumpDurationMs")) {
+        cfg.pumpDurationMs = src["pumpDurationMs"].as<uint32_t>();
+        cfg.present |= CFG_PUMP_DURATION;
+    }
+    if (src.containsKey("soilThresholdPercent")) {
+        cfg.soilThresholdPercent = src["soilThresholdPercent"].as<int>();
+        cfg.present |= CFG_SOIL_THRESHOLD;
+    }
+    if (src.containsKey("lowBatteryMilliVolts")) {
+        cfg.lowBatteryMilliVolts = src["lowBatteryMilliVolts"].as<int>();
+        cfg.present |= CFG_LOW_BATTERY;
+    }
+    if (src.containsKey("lowSoilPercent")) {
+        cfg.lowSoilPercent = src["lowSoilPercent"].as<int>();
+        cfg.present |= CFG_LOW_SOIL;
+    }
+    if (src.containsKey("waterLevelThreshold")) {
+        cfg.waterLevelThreshold = src["waterLevelThreshold"].as<uint16_t>();
+        cfg.present |= CFG_WATER_THRESHOLD;
+    }
+    if (src.containsKey("alarmSoundEnabled")) {
+        cfg.alarmSoundEnabled = src["alarmSoundEnabled"].as<bool>();
+        cfg.present |= CFG_ALARM_SOUND;
+    }
+    if (src.containsKey("soilDryAdc")) {
+        cfg.soilDryAdc = src["soilDryAdc"].as<int>();
+        cfg.present |= CFG_SOIL_DRY_ADC;
+    }
+    if (src.containsKey("soilWetAdc")) {
+        cfg.soilWetAdc = src["soilWetAdc"].as<int>();
+        cfg.present |= CFG_SOIL_WET_ADC;
+    }
+    if (src.containsKey("pumpPowerPercent")) {
+        cfg.pumpPowerPercent = src["pumpPowerPercent"].as<int>();
+        cfg.present |= CFG_PUMP_POWER;
+    }
+    if (src.containsKey("measurementHour") && src.containsKey("measurementMinute")) {
+        cfg.measurementHour = src["measurementHour"].as<int>();
+        cfg.measurementMinute = src["measurementMinute"].as<int>();
+        cfg.present |= CFG_MEASUREMENT_TIME;
+    }
+}
+
+// Przekazuje konfigurację do loop()
+static void queueConfig(const BackendConfig& cfg) {
+    // Kolejka pełna = loop() jeszcze nie przetworzył poprzednich; nowsza konfiguracja i tak przyjdzie za chwilę
+    // (znana wersja się nie zmienia, więc kolejne zapytanie warunkowe znów ją pobierze)
+    if (xQueueSend(s_configQueue, &cfg, 0) != pdTRUE) {
+        Serial.println(F("[Backend] Kolejka konfiguracji pełna - pomijam."));
+    } else {
+        s_knownConfigVersion = cfg.version;
+        schedulerNotify();
+    }
+}
+
+// ETag w postaci "<wersja>" (z cudzysłowami lub bez; W/ dla słabych ETagów)
+static uint32_t parseConfigETag(const char* etag) {
+    const char* p = etag;
+    if (strncmp(p, "W/", 2) == 0) p += 2;
+    if (*p == '"') p++;
+    return (uint32_t)strtoul(p, nullptr, 10);
+}
+
+// Przekazuje komendy do loop() i przesuwa kursor after_id
+// @return Liczba komend przekazanych do loop()
+static int queueCommands(JsonArrayConst items) {
+    int queued = 0;
+
+    // Te same komendy mogą przyjść /sync i long-pollem - kursor pod muteksem odsiewa duplikaty
+    xSemaphoreTake(s_commandMutex, portMAX_DELAY);
+    for (JsonObjectConst item : items) {
+        BackendCommand cmd;
+        cmd.id = item["id"].as<int>();
+        if (cmd.id <= s_fetchCursorId) continue;
+        cmd.type = BACKEND_CMD_UNKNOWN;
+        cmd.durationMs = 0;
+
+        const char* type = item["type"] | "";
+        if (strcmp(type, "pump") == 0) {
+            cmd.type = BACKEND_CMD_PUMP;
+            cmd.durationMs = item["payload"]["durationMs"].as<uint32_t>();
+        }
+
+        // Przy pełnej kolejce przerywamy - kursor nie rusza się, więc reszta przyjdzie w kolejnym odpytaniu
+        if (xQueueSend(s_commandQueue, &cmd, 0) != pdTRUE) {
+            Serial.println(F("[Backend] Kolejka komend pełna - dokończę w następnym cyklu."));
+            break;
+        }
+        queued++;
+        s_fetchCursorId = cmd.id;
+    }
+    xSemaphoreGive(s_commandMutex);
+
+    if (queued > 0) schedulerNotify();
+    return queued;
+}
+
+// Cel parsowania treści odpowiedzi prosto ze strumienia
+struct JsonBodyTarget {
+    JsonDocument&        doc;
+    const JsonDocument&  filter;
+    DeserializationError error;
+    bool                 parsed;
+};
+
+static void readJsonBody(Stream& body, void* context) {
+    JsonBodyTarget* target = static_cast<JsonBodyTarget*>(context);
+    target->error = deserializeJson(target->doc, body, DeserializationOption::Filter(target->filter));
+    target->parsed = true;
+}
+
+// Serwer odpowiedział sensownie - 4xx to błąd zapytania, a nie awaria backendu
+static bool isHealthyResponse(int httpCode) {
+    return httpCode > 0 && httpCode < 500;
+}
+
+// Odmowa, która nie dotyczy treści (token, przeciążenie, timeout serwera) - ponowienie ma sens
+static bool isTransientRejection(int httpCode) {
+    return httpCode == 401 || httpCode == 403 || httpCode == 408 || httpCode == 429;
+}
+
+// Serwer odrzucił samą treść - ponawianie tej samej paczki nic nie da
+static bool isContentRejection(int httpCode) {
+    return httpCode == 400 || httpCode == 413 || httpCode == 422;
+}
+
+/**
+ * @brief Wysyła telemetry snapshot (stary endpoint - dla backendu bez /sync)
+ */
+static bool sendTelemetry(const EncodedSnapshot& snap, uint8_t fields) {
+    uint8_t payload[256];
+    const char* contentType;
+    const size_t length = buildSnapshot(snap, fields, payload, sizeof(payload), contentType);
+
+    const unsigned long started = millis();
+    const int httpCode = backendClientPost(s_netSession, s_telemetryPath, contentType,
+                                           payload, length, nullptr, nullptr, 3000);
+    backendHealthReport(BACKEND_EP_SYNC, isHealthyResponse(httpCode), millis() - started);
+    linkQualityReport(isHealthyResponse(httpCode), millis() - started);
+    applyServerHints(s_netSession);
+    if (rejectBinaryTelemetry(httpCode)) {
+        return sendTelemetry(snap, fields);
+    }
+    if (httpCode > 0) {
+        Serial.printf("[Backend] Telemetry HTTP %d\n", httpCode);
+        if (httpCode >= 200 && httpCode < 300) {
+            ackSnapshot(snap, fields);
+            return true;
+        }
+    } else {
+        Serial.printf("[Backend] Błąd POST: %s\n", backendClientErrorToString(httpCode));
+    }
+
+    return false;
+}
+
+/**
+ * @brief Jedna wymiana z backendem: snapshot w górę, konfiguracja + nowe komendy w dół
+ * @param delivered [out] Czy serwer zapisał snapshot (także przez zapasowe /telemetry)
+ * @return true jeśli konfiguracja i komendy zostały odebrane (osobne odpytania niepotrzebne)
+ */
+static bool syncWithBackend(const EncodedSnapshot& snap, uint8_t fields, bool& delivered) {
+    delivered = false;
+    if (!s_syncSupported) {
+        delivered = sendTelemetry(snap, fields);
+        return false;
+    }
+    uint8_t payload[256];
+    const char* contentType;
+    const size_t length = buildSnapshot(snap, fields, payload, sizeof(payload), contentType);
+
+    char path[128];
+    snprintf(path, sizeof(path), "%s?after_id=%d&limit=%u&config_version=%u", s_syncPath, s_fetchCursorId,
+             (unsigned)COMMAND_QUEUE_LENGTH, (unsigned)s_knownConfigVersion);
+
+    StaticJsonDocument<JSON_OBJECT_SIZE(3) + CONFIG_JSON_CAPACITY + COMMANDS_JSON_CAPACITY> doc;
+    JsonBodyTarget target = { doc, s_syncFilter, DeserializationError(), false };
+    const unsigned long started = millis();
+    const int httpCode = backendClientPost(s_netSession, path, contentType,
+                                           payload, length, readJsonBody, &target, 3000);
+    backendHealthReport(BACKEND_EP_SYNC, isHealthyResponse(httpCode), millis() - started);
+    linkQualityReport(isHealthyResponse(httpCode), millis() - started);
+    applyServerHints(s_netSession);
+    if (rejectBinaryTelemetry(httpCode)) {
+        return syncWithBackend(snap, fields, delivered);
+    }
+    if (httpCode == 404) {
+        // Starszy backend bez /sync - zwykła telemetria, konfiguracja i komendy osobno (do restartu)
+        s_syncSupported = false;
+        Serial.println(F("[Backend] Brak /sync na serwerze - dalej wysyłam samą telemetrię."));
+        delivered = sendTelemetry(snap, fields);
+        return false;
+    }
+    if (httpCode <= 0) {
+        Serial.printf("[Backend] Błąd sync: %s\n", backendClientErrorToString(httpCode));
+        return false;
+    }
+    Serial.printf("[Backend] Sync HTTP %d\n", httpCode);
+    if (httpCode >= 200 && httpCode < 300) {
+        ackSnapshot(snap, fields);   // Snapshot zapisany, nawet jeśli odpowiedź okaże się nieczytelna
+        delivered = true;
+    }
+    if (!target.parsed) {
+        return false;
+    }
+    if (target.error) {
+        Serial.printf("[Backend] Błąd parsowania odpowiedzi sync: %s\n", target.error.c_str());
+        return false;
+    }
+
+    // config == null: serwer ma tę samą wersję, którą już znamy - nic do parsowania
+    JsonObjectConst config = doc["config"];
+    if (!config.isNull()) {
+        BackendConfig cfg;
+        cfg.version = doc["configVersion"] | 0;
+        parseConfig(config, cfg);
+        queueConfig(cfg);
+    }
+    queueCommands(doc["commands"]);
+    return true;
+}
+
+static const char* eventName(BackendEvent event) {
+    switch (event) {
+        case BACKEND_EVENT_ALARM:      return "alarm";
+        case BACKEND_EVENT_PUMP_START: return "start pompy";
+        case BACKEND_EVENT_PUMP_STOP:  return "stop pompy";
+        default:                       return "pomiar";
+    }
+}
+
+/**
+ * @brief Wysyła zdarzenie z czoła kolejki priorytetowej (z pominięciem otwartego obwodu - zdarzeń
+ * jest mało, a liczy się czas). Nieudane zostaje na czole do kolejnej próby.
+ */
+static void sendPendingEvent(bool forceSync) {
+    TelemetryRequest event;
+    while (xQueuePeek(s_eventQueue, &event, 0) == pdTRUE) {
+        if (s_eventAttempts > 0 && (long)(millis() - s_eventRetryAt) < 0) return;
+
+        const EncodedSnapshot snap = encodeSnapshot(event);
+        uint8_t fields;
+        snapshotFieldsToSend(snap, forceSync, fields);   // Zdarzenie idzie zawsze, nawet w martwej strefie
+        Serial.printf("[Backend] Zdarzenie priorytetowe: %s\n", eventName(event.event));
+
+        bool delivered = false;
+        if (syncWithBackend(snap, fields, delivered)) {
+            s_lastConfigCheckTime = millis();   // Konfiguracja i komendy przyszły przy okazji
+            s_configPollDelayMs = withJitter(s_pollIntervalMs);
+        }
+        if (!delivered && ++s_eventAttempts < EVENT_MAX_ATTEMPTS) {
+            s_eventRetryAt = millis() + (EVENT_RETRY_BASE_MS << (s_eventAttempts - 1));
+            Serial.printf("[Backend] Ponowienie zdarzenia za %lu ms.\n", (unsigned long)(EVENT_RETRY_BASE_MS << (s_eventAttempts - 1)));
+            return;
+        }
+        if (!delivered) {
+            Serial.println(F("[Backend] Zdarzenie niedostarczone - trafia do historii RTC."));
+            stashSnapshot(snap);
+        }
+        xQueueReceive(s_eventQueue, &event, 0);
+        s_eventAttempts = 0;
+    }
+}
+
+/**
+ * @brief Wysyła zaległe pomiary z pamięci RTC (jedno zapytanie na porcję) i usuwa potwierdzone
+ */
+static void uploadHistory() {
+    while (s_historySupported) {
+        const size_t available = telemetryHistoryPeek(s_historyBatch, TELEMETRY_HISTORY_CAPACITY);
+        if (available == 0) return;
+
+        const char* contentType;
+        size_t sent;
+        const size_t length = buildHistoryBatch(s_historyBatch, available, s_historyPayload,
+                                                sizeof(s_historyPayload), contentType, sent);
+        // Zgoda obwodu dopiero przed samym zapytaniem - próba półotwarta nie może przepaść
+        if (sent == 0 || !backendHealthAllow(BACKEND_EP_HISTORY)) return;
+
+        const unsigned long started = millis();
+        const int httpCode = backendClientPost(s_netSession, s_historyPath, contentType,
+                                               s_historyPayload, length, nullptr, nullptr, 5000);
+        // Odmowa tokenu czy limit zapytań to awaria jak 5xx: obwód się otwiera, historia czeka w RTC
+        backendHealthReport(BACKEND_EP_HISTORY, isHealthyResponse(httpCode) && !isTransientRejection(httpCode),
+                            millis() - started);
+        linkQualityReport(isHealthyResponse(httpCode), millis() - started);
+        applyServerHints(s_netSession);
+        if (rejectBinaryTelemetry(httpCode)) {
+            continue;
+        }
+        if (httpCode == 404) {
+            s_historySupported = false;
+            Serial.println(F("[Backend] Brak /telemetry/batch na serwerze - historia zostaje w RTC."));
+            return;
+        }
+        if (isContentRejection(httpCode)) {
+            // Serwer odrzucił treść - ponawianie nic nie da, a zablokowałoby resztę historii
+            telemetryHistoryAck(s_historyBatch[sent - 1].seq);
+            Serial.printf("[Backend] Historia odrzucona (HTTP %d) - usuwam %u pomiarów.\n", httpCode, (unsigned)sent);
+            continue;
+        }
+        if (httpCode < 200 || httpCode >= 300) {
+            if (httpCode > 0) {
+                Serial.printf("[Backend] Historia HTTP %d\n", httpCode);
+            } else {
+                Serial.printf("[Backend] Błąd wysyłki historii: %s\n", backendClientErrorToString(httpCode));
             }
+            return;
+        }
 
+        telemetryHistoryAck(s_historyBatch[sent - 1].seq);
+        Serial.printf("[Backend] Wysłano %u pomiarów z historii.\n", (unsigned)sent);
+    }
+}
+
+static void fetchConfiguration() {
+    // Obwód otwarty: zostajemy przy konfiguracji zapisanej we Flash
+    if (!backendHealthAllow(BACKEND_EP_CONFIG)) return;
+
+    // Zapytanie warunkowe: w typowym przypadku 304 bez treści - zero parsowania i porównań
+    char etag[16];
+    snprintf(etag, sizeof(etag), "\"%u\"", (unsigned)s_knownConfigVersion);
+
+    StaticJsonDocument<CONFIG_JSON_CAPACITY> doc;
+    JsonBodyTarget target = { doc, s_configFilter, DeserializationError(), false };
+    const unsigned long started = millis();
+    int httpCode = backendClientGet(s_netSession, s_configPath, s_knownConfigVersion ? etag : nullptr,
+                                    readJsonBody, &target, 2000);
+    backendHealthReport(BACKEND_EP_CONFIG, isHealthyResponse(httpCode), millis() - started);
+    linkQualityReport(isHealthyResponse(httpCode), millis() - started);
+    applyServerHints(s_netSession);
+    if (httpCode == HTTP_CODE_NOT_MODIFIED) {
+        return;
+    }
+    if (httpCode == 200) {
+        if (!target.error) {
+            BackendConfig cfg;
+            cfg.version = parseConfigETag(backendClientLastETag(s_netSession));
+            parseConfig(doc.as<JsonObjectConst>(), cfg);
+            queueConfig(cfg);
         } else {
-            Serial.printf("[Backend] Błąd parsowania konfiguracji JSON: %s\n", error.c_str());
+            Serial.printf("[Backend] Błąd parsowania konfiguracji JSON: %s\n", target.error.c_str());
         }
     }
-    http.end();
 }
 
-void fetchAndExecuteCommands(int currentWaterLevel) {
-    static bool firstCheckDone = false; 
+/**
+ * @brief Wysyła do backendu konfigurację zmienioną przez lokalne API (PUT zastępuje całą konfigurację).
+ * Nieudana zostaje w skrzynce do kolejnego obiegu, chyba że loop() zdążył wstawić nowszą.
+ */
+static void pushLocalConfiguration() {
+    BackendConfig cfg;
+    if (xQueueReceive(s_configPushQueue, &cfg, 0) != pdTRUE) return;
+    if (!backendHealthAllow(BACKEND_EP_CONFIG)) {
+        xQueueSend(s_configPushQueue, &cfg, 0);
+        return;
+    }
+
+    char payload[384];
+    const int length = snprintf(payload, sizeof(payload),
+        "{\"continuousMode\":%s,\"pumpDurationMs\":%lu,\"soilThresholdPercent\":%d,"
+        "\"lowBatteryMilliVolts\":%d,\"lowSoilPercent\":%d,\"waterLevelThreshold\":%u,"
+        "\"alarmSoundEnabled\":%s,\"soilDryAdc\":%d,\"soilWetAdc\":%d,\"pumpPowerPercent\":%d,"
+        "\"measurementHour\":%d,\"measurementMinute\":%d}",
+        cfg.continuousMode ? "true" : "false", (unsigned long)cfg.pumpDurationMs, cfg.soilThresholdPercent,
+        cfg.lowBatteryMilliVolts, cfg.lowSoilPercent, (unsigned)cfg.waterLevelThreshold,
+        cfg.alarmSoundEnabled ? "true" : "false", cfg.soilDryAdc, cfg.soilWetAdc, cfg.pumpPowerPercent,
+        cfg.measurementHour, cfg.measurementMinute);
+
+    // source=device: backend nie traktuje tego jak otwartej aplikacji (bez szybkiego odpytywania)
+    char path[128];
+    snprintf(path, sizeof(path), "%s?source=device", s_configPath);
 
-    if (!firstCheckDone || (millis() - g_lastCommandCheckTime >= COMMAND_CHECK_INTERVAL_MS)) {
-        g_lastCommandCheckTime = millis();
-        firstCheckDone = true;
+    const unsigned long started = millis();
+    const int httpCode = backendClientPut(s_netSession, path, "application/json",
+                                          (const uint8_t*)payload, (size_t)length, nullptr, nullptr, 2000);
+    backendHealthReport(BACKEND_EP_CONFIG, isHealthyResponse(httpCode) && !isTransientRejection(httpCode),
+                        millis() - started);
+    linkQualityReport(isHealthyResponse(httpCode), millis() - started);
+    applyServerHints(s_netSession);
+
+    if (httpCode >= 200 && httpCode < 300) {
+        // Wersja nieznana -> kolejne odpytanie pobierze konfigurację z nową wersją serwera
+        // (i zapisze ją we Flash), a urządzenie i backend mają ten sam stan
+        s_knownConfigVersion = 0;
+        Serial.println(F("[Backend] Lokalna zmiana konfiguracji wysłana do backendu."));
+        return;
+    }
+    if (isContentRejection(httpCode)) {
+        Serial.printf("[Backend] Backend odrzucił lokalną konfigurację (HTTP %d) - przy kolejnej zmianie w aplikacji wygra wersja z serwera.\n", httpCode);
+        return;
+    }
+    if (httpCode > 0) {
+        Serial.printf("[Backend] PUT konfiguracji HTTP %d\n", httpCode);
     } else {
-        return; 
+        Serial.printf("[Backend] Błąd PUT konfiguracji: %s\n", backendClientErrorToString(httpCode));
     }
+    xQueueSend(s_configPushQueue, &cfg, 0);
+}
 
-    if (WiFi.status() != WL_CONNECTED) return; 
+/**
+ * @brief Pobiera nowe komendy (waitSec > 0: long-poll, serwer odpowiada dopiero gdy coś ma albo po czasie)
+ * @return Liczba komend przekazanych do loop() albo -1 przy błędzie (także gdy obwód jest otwarty)
+ */
+static int fetchCommands(BackendSession& session, uint8_t waitSec, uint16_t timeoutMs) {
+    if (!backendHealthAllow(BACKEND_EP_COMMANDS)) return -1;
 
-    HTTPClient http;
-    String url = String(FLORA_BACKEND_BASE_URL) + "/api/flora/" + FLORA_BACKEND_DEVICE_ID + "/commands?after_id=" + String(g_lastCommandId);
-    
-    http.begin(url);
-    http.setTimeout(2000); 
-    http.addHeader("Authorization", String("Bearer ") + FLORA_BACKEND_TOKEN);
+    char path[128];
+    snprintf(path, sizeof(path), "%s?after_id=%d&limit=%u&wait=%u", s_commandsPath, s_fetchCursorId,
+             (unsigned)COMMAND_QUEUE_LENGTH, (unsigned)waitSec);
 
-    int httpCode = http.GET();
-    if (httpCode >= 200 && httpCode < 300) {
-        String payload = http.getString();
-        DynamicJsonDocument doc(4096);
-        DeserializationError error = deserializeJson(doc, payload);
-
-        if (!error) {
-            JsonArray items = doc["items"];
-            bool pumpTriggeredInThisBatch = false; // Tarcza antyspamowa!
-
-            for (JsonObject item : items) {
-                int currentId = item["id"].as<int>();
-                String type = item["type"].as<String>();
-
-                if (type == "pump") {
-                    int durationMs = item["payload"]["durationMs"].as<int>();
-                    
-                    if (currentWaterLevel <= 0) {
-                        Serial.println("[Backend] Odrzucono komendę z aplikacji - BRAK WODY!");
-                    } else if (!pumpTriggeredInThisBatch) {
-                        Serial.printf("[Backend] Wykryto komendę PUMP! Czas: %d ms\n", durationMs);
-                        pumpControlManualTurnOn(durationMs);
-                        pumpTriggeredInThisBatch = true; 
-                    } else {
-                        Serial.printf("[Backend] Zignorowano powieloną komendę PUMP (ID: %d) - antyspam!\n", currentId);
-                    }
-                }
+    StaticJsonDocument<JSON_OBJECT_SIZE(1) + COMMANDS_JSON_CAPACITY> doc;
+    JsonBodyTarget target = { doc, s_commandsFilter, DeserializationError(), false };
+    const unsigned long started = millis();
+    int httpCode = backendClientGet(session, path, nullptr, readJsonBody, &target, timeoutMs);
+    // Serwer celowo trzyma long-poll do waitSec - czasem blokady jest tylko to, co ponad
+    const unsigned long elapsed = millis() - started;
+    const unsigned long heldMs = (unsigned long)waitSec * 1000UL;
+    backendHealthReport(BACKEND_EP_COMMANDS, isHealthyResponse(httpCode), elapsed > heldMs ? elapsed - heldMs : 0);
+    applyServerHints(session);
+    if (httpCode < 200 || httpCode >= 300) {
+        if (httpCode <= 0) {
+            Serial.printf("[Backend] Błąd GET komend: %s\n", backendClientErrorToString(httpCode));
+        }
+        return -1;
+    }
 
-                if (currentId > g_lastCommandId) {
-                    g_lastCommandId = currentId;
-                    configSetLastCommandId(g_lastCommandId); 
-                }
+    if (target.error) {
+        Serial.printf("[Backend] Błąd parsowania komend JSON: %s\n", target.error.c_str());
+        return -1;
+    }
+    return queueCommands(doc["items"]);
+}
+
+// =============================================================
+//  Stosowanie konfiguracji (wywoływane z loop())
+// =============================================================
+
+// Pełna bieżąca konfiguracja w jednostkach backendu (do PUT /config)
+static BackendConfig currentConfiguration() {
+    BackendConfig cfg;
+    cfg.present = CFG_CONTINUOUS_MODE | CFG_PUMP_DURATION | CFG_SOIL_THRESHOLD | CFG_LOW_BATTERY |
+                  CFG_LOW_SOIL | CFG_WATER_THRESHOLD | CFG_ALARM_SOUND | CFG_SOIL_DRY_ADC |
+                  CFG_SOIL_WET_ADC | CFG_PUMP_POWER | CFG_MEASUREMENT_TIME;
+    cfg.continuousMode       = configIsContinuousMode();
+    cfg.pumpDurationMs       = configGetPumpRunMillis();
+    cfg.soilThresholdPercent = configGetSoilThresholdPercent();
+    cfg.lowBatteryMilliVolts = configGetLowBatteryMilliVolts();
+    cfg.lowSoilPercent       = configGetLowSoilPercent();
+    cfg.waterLevelThreshold  = configGetWaterLevelThreshold();
+    cfg.alarmSoundEnabled    = configIsAlarmSoundEnabled();
+    cfg.soilDryAdc           = configGetSoilDryADC();
+    cfg.soilWetAdc           = configGetSoilWetADC();
+    // Zaokrąglenie - procent z powrotem daje ten sam duty (np. 50% -> 127 -> 50%)
+    cfg.pumpPowerPercent     = (configGetPumpDutyCycle() * 100 + 127) / 255;
+    cfg.measurementHour      = configGetMeasurementHour();
+    cfg.measurementMinute    = configGetMeasurementMinute();
+    return cfg;
+}
+
+static void applyConfiguration(const BackendConfig& cfg) {
+    // 1. Tryb ciągły
+    if ((cfg.present & CFG_CONTINUOUS_MODE) && cfg.continuousMode != configIsContinuousMode()) {
+        configSetContinuousMode(cfg.continuousMode);
+        Serial.printf("[Backend] -> Zmieniono Tryb Ciągły na: %s\n", cfg.continuousMode ? "TAK" : "NIE");
+    }
+
+    // 2. Czas pracy pompy
+    if ((cfg.present & CFG_PUMP_DURATION) && cfg.pumpDurationMs != configGetPumpRunMillis()) {
+        configSetPumpRunMillis(cfg.pumpDurationMs);
+        Serial.printf("[Backend] -> Zmieniono Czas Pracy Pompy na: %lu ms\n", (unsigned long)cfg.pumpDurationMs);
+    }
+
+    // 3. Próg wilgotności dla uruchomienia pompy
+    if ((cfg.present & CFG_SOIL_THRESHOLD) && cfg.soilThresholdPercent != configGetSoilThresholdPercent()) {
+        configSetSoilThresholdPercent(cfg.soilThresholdPercent);
+        Serial.printf("[Backend] -> Zmieniono Próg Podlewania na: %d %%\n", cfg.soilThresholdPercent);
+    }
+
+    // 4. Próg alarmu niskiej baterii
+    if ((cfg.present & CFG_LOW_BATTERY) && cfg.lowBatteryMilliVolts != configGetLowBatteryMilliVolts()) {
+        configSetLowBatteryMilliVolts(cfg.lowBatteryMilliVolts);
+        Serial.printf("[Backend] -> Zmieniono Próg Baterii na: %d mV\n", cfg.lowBatteryMilliVolts);
+    }
+
+    // 5. Próg alarmu suchej gleby
+    if ((cfg.present & CFG_LOW_SOIL) && cfg.lowSoilPercent != configGetLowSoilPercent()) {
+        configSetLowSoilPercent(cfg.lowSoilPercent);
+        Serial.printf("[Backend] -> Zmieniono Próg Alarmu Gleby na: %d %%\n", cfg.lowSoilPercent);
+    }
+
+    // 6. Próg detekcji wody w zbiorniku
+    if ((cfg.present & CFG_WATER_THRESHOLD) && cfg.waterLevelThreshold != configGetWaterLevelThreshold()) {
+        configSetWaterLevelThreshold(cfg.waterLevelThreshold);
+        Serial.printf("[Backend] -> Zmieniono Próg Wykrycia Wody na: %u ADC\n", cfg.waterLevelThreshold);
+    }
+
+    // 7. Dźwięk alarmu
+    if ((cfg.present & CFG_ALARM_SOUND) && cfg.alarmSoundEnabled != configIsAlarmSoundEnabled()) {
+        configSetAlarmSoundEnabled(cfg.alarmSoundEnabled);
+        Serial.printf("[Backend] -> Zmieniono Dźwięk Alarmu na: %s\n", cfg.alarmSoundEnabled ? "Włączony" : "Wyłączony");
+    }
+
+    // 8. Kalibracja czujnika wilgotności - SUCHO
+    if ((cfg.present & CFG_SOIL_DRY_ADC) && cfg.soilDryAdc != configGetSoilDryADC()) {
+        configSetSoilDryADC(cfg.soilDryAdc);
+        Serial.printf("[Backend] -> Zmieniono Kalibrację SUCHO na: %d ADC\n", cfg.soilDryAdc);
+    }
+
+    // 9. Kalibracja czujnika wilgotności - MOKRO
+    if ((cfg.present & CFG_SOIL_WET_ADC) && cfg.soilWetAdc != configGetSoilWetADC()) {
+        configSetSoilWetADC(cfg.soilWetAdc);
+        Serial.printf("[Backend] -> Zmieniono Kalibrację MOKRO na: %d ADC\n", cfg.soilWetAdc);
+    }
+
+    // 10. Moc pompy (Z procentów 0-100 na PWM 0-255)
+    if (cfg.present & CFG_PUMP_POWER) {
+        uint8_t dutyCycle = (uint8_t)((cfg.pumpPowerPercent * 255) / 100);
+        if (dutyCycle != configGetPumpDutyCycle()) {
+            configSetPumpDutyCycle(dutyCycle);
+            Serial.printf("[Backend] -> Zmieniono Moc Pompy na: %d%% (Duty: %d)\n", cfg.pumpPowerPercent, dutyCycle);
+        }
+    }
+
+    // 11 i 12. Godzina i Minuta pomiaru (Używamy jednej łączonej funkcji settera)
+    if (cfg.present & CFG_MEASUREMENT_TIME) {
+        if (cfg.measurementHour != configGetMeasurementHour() || cfg.measurementMinute != configGetMeasurementMinute()) {
+            if (configSetMeasurementTime(cfg.measurementHour, cfg.measurementMinute)) {
+                Serial.printf("[Backend] -> Zmieniono Czas Pomiaru na: %02d:%02d\n", cfg.measurementHour, cfg.measurementMinute);
             }
         }
     }
-    http.end();
-}
\ No newline at end of file
+
+    // Zapamiętujemy wersję - po restarcie zapytanie warunkowe zwróci 304, jeśli nic się nie zmieniło
+    if (cfg.version != 0 && cfg.version != g_appliedConfigVersion) {
+        g_appliedConfigVersion = cfg.version;
+        configSetBackendConfigVersion(cfg.version);
+    }
+}
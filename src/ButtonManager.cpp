@@ -1,6 +1,7 @@
 
 #include "ButtonManager.h"
 #include "DeviceConfig.h" // Dla configGetButtonPin() i configIsContinuousMode()
+#include "Scheduler.h"    // Budzenie pętli głównej z przerwania
 #include <Arduino.h>      // Dla pinMode, digitalRead, millis()
 
 // Zmienne statyczne (widoczne tylko w tym pliku)
@@ -10,12 +11,18 @@ static int lastButtonState = HIGH;         // Poprzedni odczytany stan (do debou
 static unsigned long lastDebounceTime = 0; // Czas ostatniej zmiany stanu
 const unsigned long debounceDelay = 50;   // Czas stabilizacji (ms)
 
+// Przerwanie na każdym zboczu - tylko budzi pętlę główną, cała logika zostaje w buttonWasPressed()
+static void IRAM_ATTR buttonIsr() {
+    schedulerNotifyFromISR();
+}
+
 void buttonSetup() {
     buttonPin = configGetButtonPin(); // Pobierz pin z konfiguracji
     if (buttonPin != 255) {
         // Ustaw jako wejście z podciąganiem do VCC.
         // Odczyt LOW będzie oznaczał naciśnięcie.
         pinMode(buttonPin, INPUT_PULLUP);
+        attachInterrupt(digitalPinToInterrupt(buttonPin), buttonIsr, CHANGE);
         Serial.printf("  [Button] Skonfigurowano pin przycisku %d jako INPUT_PULLUP.\n", buttonPin);
     } else {
         Serial.println("  [Button] OSTRZEŻENIE: Pin przycisku nieskonfigurowany!");
@@ -57,4 +64,25 @@ bool buttonWasPressed() {
 
     lastButtonState = reading; // Zapisz bieżący odczyt do następnej iteracji
     return pressedEvent; // Zwróć true tylko w momencie wykrycia naciśnięcia
+}
+
+uint32_t buttonNextUpdateMs() {
+    if (buttonPin == 255 || !configIsContinuousMode()) {
+        return SCHEDULER_IDLE;
+    }
+
+    int reading = digitalRead(buttonPin);
+
+    // Nowe zbocze - trzeba zresetować timer debouncingu
+    if (reading != lastButtonState) {
+        return 0;
+    }
+
+    // Odczyt różni się od stabilnego stanu - czekamy aż minie czas stabilizacji
+    if (reading != buttonState) {
+        unsigned long elapsed = millis() - lastDebounceTime;
+        return (elapsed > debounceDelay) ? 0 : (debounceDelay - elapsed + 1);
+    }
+
+    return SCHEDULER_IDLE;
 }
\ No newline at end of file
@@ -13,6 +13,7 @@ const char* PREF_NAMESPACE = "flaura_cfg_1";
 // --- Nowe klucze dla trwałej pamięci komend ---
 static const char* NVS_NAMESPACE_CMDS = "flora_cmds";
 static const char* KEY_LAST_ID = "last_id";
+static const char* KEY_CFG_VERSION = "cfg_ver";
 
 const char* PREF_SOIL_PIN       = "soilPin";
 const char* PREF_SOIL_DRY       = "soilDry";
@@ -248,6 +249,22 @@ void configSetLastCommandId(int id) {
     Serial.printf("  [Config] Zapisano nowy LastCommandID do Flash: %d\n", id);
 }
 
+uint32_t configGetBackendConfigVersion() {
+    Preferences cmdsPrefs;
+    cmdsPrefs.begin(NVS_NAMESPACE_CMDS, true); // Tryb tylko do odczytu
+    uint32_t version = cmdsPrefs.getUInt(KEY_CFG_VERSION, 0); // 0 = jeszcze nic nie pobrano
+    cmdsPrefs.end();
+    return version;
+}
+
+void configSetBackendConfigVersion(uint32_t version) {
+    Preferences cmdsPrefs;
+    cmdsPrefs.begin(NVS_NAMESPACE_CMDS, false); // Tryb do zapisu
+    cmdsPrefs.putUInt(KEY_CFG_VERSION, version);
+    cmdsPrefs.end();
+    Serial.printf("  [Config] Zapisano wersję konfiguracji backendu: %u\n", version);
+}
+
 // =============================================================
 //  Gettery
 // =============================================================
@@ -363,10 +380,12 @@ bool configSetMeasurementTime(int hour, int minute) {
 }
 
 void configSetContinuousMode(bool enabled) {
-    continuousMode = enabled;
-    preferences.begin(PREF_NAMESPACE, false);
-    preferences.putBool(PREF_CONT_MODE, continuousMode);
-    preferences.end();
+    if (continuousMode != enabled) {
+        continuousMode = enabled;
+        preferences.begin(PREF_NAMESPACE, false);
+        preferences.putBool(PREF_CONT_MODE, continuousMode);
+        preferences.end();
+    }
 }
 
 void configSetAlarmSoundEnabled(bool enabled) {
@@ -66,12 +66,26 @@ void environmentSensorSetup() {
     Serial.println("  [DHT11] Konfiguracja pinów zakończona. Sensor gotowy do użycia (zasilanie wyłączone).");
 }
 
-bool environmentSensorRead(float &temperature, float &humidity) {
+// Stan odczytu nieblokującego
+enum DhtReadState { DHT_IDLE, DHT_SETTLING, DHT_DONE };
+static DhtReadState  readState = DHT_IDLE;
+static unsigned long powerOnTime = 0;
+static float lastTemperature = NAN;
+static float lastHumidity = NAN;
+static bool  lastReadOk = false;
+
+static void finishRead(bool ok, float temperature, float humidity) {
+    lastReadOk = ok;
+    lastTemperature = ok ? temperature : NAN;  // Upewnij się, że zwracasz NAN w razie błędu
+    lastHumidity = ok ? humidity : NAN;
+    readState = DHT_DONE;
+}
+
+void environmentSensorBeginRead() {
     // Sensor opcjonalny: dla profilu bez DHT po prostu zwracamy brak odczytu.
     if (dhtPowerPin == 255 || dhtDataPin == 255) {
-        temperature = NAN;
-        humidity = NAN;
-        return false;
+        finishRead(false, NAN, NAN);
+        return;
     }
 
     // Sprawdź, czy obiekt istnieje
@@ -80,50 +94,67 @@ bool environmentSensorRead(float &temperature, float &humidity) {
         dht_sensor = new DHT(dhtDataPin, DHTTYPE);
         if (dht_sensor == nullptr) {
             Serial.println("  [DHT11 Read] BŁĄD: Alokacja pamięci dla DHT nieudana.");
-            temperature = NAN;
-            humidity = NAN;
-            return false;
+            finishRead(false, NAN, NAN);
+            return;
         }
     }
 
-    bool readOk = false; // Flaga sukcesu odczytu
-
     // --- Sekwencja odczytu z przełączaniem zasilania ---
-    // 1. Włącz zasilanie
+    // 1. Włącz zasilanie i zacznij odliczać czas stabilizacji (bez delay())
     digitalWrite(dhtPowerPin, HIGH);
-    // Serial.println("  [DHT11 Read] Zasilanie ON");
+    powerOnTime = millis();
+    readState = DHT_SETTLING;
+}
 
+bool environmentSensorPoll() {
+    if (readState != DHT_SETTLING) {
+        return readState == DHT_DONE;
+    }
     // 2. Poczekaj na stabilizację
-    // Serial.printf("  [DHT11 Read] Czekam %lu ms na stabilizację...\n", DHT_STABILIZATION_DELAY_MS);
-    delay(DHT_STABILIZATION_DELAY_MS);
+    if (millis() - powerOnTime < DHT_STABILIZATION_DELAY_MS) {
+        return false;
+    }
 
     // 3. Zainicjuj komunikację (begin() jest wymagane po włączeniu zasilania)
     dht_sensor->begin();
-    // Można dodać krótki delay po begin, jeśli wymagane
-    // delay(50);
 
     // 4. Odczytaj wartości
-    // Serial.println("  [DHT11 Read] Próba odczytu...");
-    humidity = dht_sensor->readHumidity();
-    temperature = dht_sensor->readTemperature(); // Domyślnie w stopniach Celsjusza
+    float humidity = dht_sensor->readHumidity();
+    float temperature = dht_sensor->readTemperature(); // Domyślnie w stopniach Celsjusza
 
     // 5. Wyłącz zasilanie (zrób to od razu po odczycie)
     digitalWrite(dhtPowerPin, LOW);
-    // Serial.println("  [DHT11 Read] Zasilanie OFF");
     // --- Koniec sekwencji ---
 
     // 6. Sprawdź wynik odczytu
     if (isnan(humidity) || isnan(temperature)) {
         Serial.println("  [DHT11 Read] BŁĄD: Odczyt z czujnika DHT11 nieudany!");
-        temperature = NAN; // Upewnij się, że zwracasz NAN w razie błędu
-        humidity = NAN;
         isDhtInitialized = false; // Ostatni odczyt nieudany
-        readOk = false;
+        finishRead(false, NAN, NAN);
     } else {
         Serial.printf("  [DHT11 Read] Odczytano: Temp=%.1f°C, Wilg=%.1f%%\n", temperature, humidity);
         isDhtInitialized = true; // Ostatni odczyt udany
-        readOk = true;
+        finishRead(true, temperature, humidity);
     }
+    return true;
+}
+
+uint32_t environmentSensorNextPollMs() {
+    if (readState != DHT_SETTLING) return 0;
+    unsigned long elapsed = millis() - powerOnTime;
+    return elapsed >= DHT_STABILIZATION_DELAY_MS ? 0 : (uint32_t)(DHT_STABILIZATION_DELAY_MS - elapsed);
+}
 
-    return readOk; // Zwróć status odczytu
+bool environmentSensorResult(float &temperature, float &humidity) {
+    temperature = lastTemperature;
+    humidity = lastHumidity;
+    return lastReadOk;
+}
+
+bool environmentSensorRead(float &temperature, float &humidity) {
+    environmentSensorBeginRead();
+    while (!environmentSensorPoll()) {
+        delay(environmentSensorNextPollMs());
+    }
+    return environmentSensorResult(temperature, humidity); // Zwróć status odczytu
 }
@@ -1,5 +1,6 @@
 // LedManager.cpp
 #include "LedManager.h"
+#include "Scheduler.h"
 #include <Arduino.h>
 
 // --- Zmienne statyczne (prywatne dla tego pliku) ---
@@ -135,4 +136,24 @@ void ledManagerUpdate() {
         _isBlinkingLedOn  = !_isBlinkingLedOn;
         digitalWrite(_ledPin, _isBlinkingLedOn ? _ledOnState : _ledOffState);
     }
+}
+
+uint32_t ledManagerNextUpdateMs() {
+    if (_ledPin == -1) return SCHEDULER_IDLE;
+
+    unsigned long now = millis();
+    unsigned long elapsed;
+    unsigned long interval;
+
+    if (_isSingleBlinkActive) {
+        elapsed  = now - _singleBlinkStartTime;
+        interval = _singleBlinkDuration;
+    } else if (_currentState == LED_BLINKING_SLOW || _currentState == LED_BLINKING_FAST) {
+        elapsed  = now - _lastBlinkTime;
+        interval = (_currentState == LED_BLINKING_SLOW) ? BLINK_INTERVAL_SLOW : BLINK_INTERVAL_FAST;
+    } else {
+        return SCHEDULER_IDLE;
+    }
+
+    return (elapsed >= interval) ? 0 : (uint32_t)(interval - elapsed);
 }
\ No newline at end of file
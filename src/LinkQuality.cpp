@@ -0,0 +1,83 @@
+// LinkQuality.cpp
+#include "LinkQuality.h"
+#include <Arduino.h>
+#include <WiFi.h>
+
+// Progi słabego łącza
+static const int8_t   POOR_RSSI_DBM        = -80;
+static const uint16_t POOR_RTT_MS          = 2000;
+static const uint8_t  POOR_FAILURE_PERCENT = 50;
+
+// Private variables (pamięć RTC - statystyki obejmują kolejne wybudzenia)
+RTC_DATA_ATTR static int8_t   rssi = 0;
+RTC_DATA_ATTR static uint16_t rttMs = 0;            // 0 = brak udanego zapytania
+RTC_DATA_ATTR static uint8_t  failurePercent = 0;
+RTC_DATA_ATTR static uint16_t totalDeferrals = 0;
+RTC_DATA_ATTR static uint8_t  pendingDeferrals = 0;
+static portMUX_TYPE           linkMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Średnia krocząca z wagą 1/4 dla nowej próbki
+static uint32_t ewma(uint32_t average, uint32_t sample) {
+    return (average * 3 + sample) / 4;
+}
+
+void linkQualityReport(bool success, uint32_t elapsedMs) {
+    const int32_t currentRssi = WiFi.RSSI();
+
+    portENTER_CRITICAL(&linkMux);
+    if (currentRssi < 0) rssi = (int8_t)max(currentRssi, (int32_t)INT8_MIN);
+    failurePercent = (uint8_t)ewma(failurePercent, success ? 0 : 100);
+    if (success) {
+        const uint32_t sample = min(elapsedMs, (uint32_t)UINT16_MAX);
+        rttMs = (uint16_t)(rttMs == 0 ? sample : ewma(rttMs, sample));
+    }
+    portEXIT_CRITICAL(&linkMux);
+}
+
+bool linkQualityShouldDefer() {
+    const int32_t currentRssi = WiFi.RSSI();
+    const char* reason = nullptr;
+
+    portENTER_CRITICAL(&linkMux);
+    if (currentRssi < 0) rssi = (int8_t)max(currentRssi, (int32_t)INT8_MIN);
+    if (rssi < POOR_RSSI_DBM) {
+        reason = "słaby sygnał";
+    } else if (rttMs > POOR_RTT_MS) {
+        reason = "wolne odpowiedzi";
+    } else if (failurePercent >= POOR_FAILURE_PERCENT) {
+        reason = "częste błędy";
+    }
+
+    bool defer = false;
+    if (reason != nullptr && pendingDeferrals < LINK_MAX_CONSECUTIVE_DEFERRALS) {
+        pendingDeferrals++;
+        totalDeferrals++;
+        defer = true;
+    } else {
+        pendingDeferrals = 0;
+    }
+    const LinkMetrics snapshot = { rssi, rttMs, failurePercent, totalDeferrals };
+    portEXIT_CRITICAL(&linkMux);
+
+    if (defer) {
+        Serial.printf("[Link] Odkładam wysyłkę (%s): RSSI %d dBm, RTT %u ms, błędy %u%%.\n", reason,
+                      snapshot.rssi, snapshot.rttMs, snapshot.failurePercent);
+    } else if (reason != nullptr) {
+        Serial.printf("[Link] Limit odłożeń wyczerpany - wysyłam mimo słabego łącza (%s).\n", reason);
+    }
+    return defer;
+}
+
+uint8_t linkQualityPendingDeferrals() {
+    portENTER_CRITICAL(&linkMux);
+    const uint8_t pending = pendingDeferrals;
+    portEXIT_CRITICAL(&linkMux);
+    return pending;
+}
+
+LinkMetrics linkQualityMetrics() {
+    portENTER_CRITICAL(&linkMux);
+    const LinkMetrics metrics = { rssi, rttMs, failurePercent, totalDeferrals };
+    portEXIT_CRITICAL(&linkMux);
+    return metrics;
+}
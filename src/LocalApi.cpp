@@ -0,0 +1,220 @@
+// LocalApi.cpp
+#include "LocalApi.h"
+#include "AlarmManager.h"
+#include "BackendTasks.h"
+#include "DeviceConfig.h"
+#include "PumpControl.h"
+#include "Scheduler.h"
+#include "SensorBus.h"
+#include "WiFiConnection.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <WebServer.h>
+#include <WiFi.h>
+
+#if __has_include("secrets.h")
+#include "secrets.h"
+#endif
+
+// 0 = lokalne API wyłączone
+#ifndef FLORA_LOCAL_API
+#define FLORA_LOCAL_API 1
+#endif
+
+#ifndef FLORA_LOCAL_API_PORT
+#define FLORA_LOCAL_API_PORT 80
+#endif
+
+// Osobny token - token backendu nie może krążyć po LAN (bez własnego tokenu API jest wyłączone)
+#ifndef FLORA_LOCAL_API_TOKEN
+#define FLORA_LOCAL_API_TOKEN ""
+#endif
+
+// Co ile obsługujemy gniazdo serwera - odpowiedź w LAN w kilkanaście-kilkadziesiąt ms
+static const uint32_t LOCAL_API_POLL_INTERVAL_MS = 10;
+// Bez WiFi sprawdzamy co tyle, czy można już wystartować serwer
+static const uint32_t LOCAL_API_WIFI_CHECK_MS = 1000;
+// Zakres czasu pompy jak w POST /actions/pump backendu
+static const uint32_t LOCAL_PUMP_MIN_MS = 500;
+static const uint32_t LOCAL_PUMP_MAX_MS = 30000;
+
+// Private variables
+static WebServer*            server = nullptr;   // Istnieje tylko w trybie ciągłym z połączeniem WiFi
+static LocalApiConfigHandler configHandler = nullptr;
+static unsigned long         lastProcessTime = 0;
+static bool                  tokenMissingReported = false;
+
+static void sendJson(int code, const char* body) {
+    server->send(code, "application/json", body);
+}
+
+// Porównanie w stałym czasie - czas odpowiedzi nie zdradza, ile znaków tokenu się zgadza
+static bool authorized() {
+    static const char PREFIX[] = "Bearer ";
+    const String header = server->header("Authorization");
+    const char* expected = FLORA_LOCAL_API_TOKEN;
+    const size_t expectedLength = strlen(expected);
+    if (header.length() != sizeof(PREFIX) - 1 + expectedLength || !header.startsWith(PREFIX)) {
+        sendJson(401, "{\"error\":\"unauthorized\"}");
+        return false;
+    }
+
+    const char* provided = header.c_str() + sizeof(PREFIX) - 1;
+    uint8_t diff = 0;
+    for (size_t i = 0; i < expectedLength; i++) diff |= (uint8_t)(provided[i] ^ expected[i]);
+    if (diff != 0) {
+        sendJson(401, "{\"error\":\"unauthorized\"}");
+        return false;
+    }
+    return true;
+}
+
+static void appendNumberOrNull(char* buf, size_t size, const char* key, float value, bool last) {
+    const size_t used = strlen(buf);
+    if (isnan(value)) {
+        snprintf(buf + used, size - used, "\"%s\":null%s", key, last ? "" : ",");
+    } else {
+        snprintf(buf + used, size - used, "\"%s\":%.2f%s", key, value, last ? "" : ",");
+    }
+}
+
+static void handleStatus() {
+    if (!authorized()) return;
+
+    const SensorData& data = sensorBusLatest();
+    char body[320];
+    snprintf(body, sizeof(body),
+             "{\"version\":%lu,\"soilMoisture\":%d,\"waterLevel\":%d,\"pumpRunning\":%s,"
+             "\"alarmActive\":%s,\"continuousMode\":%s,\"dhtOk\":%s,\"uptimeMs\":%lu,",
+             (unsigned long)sensorBusVersion(), data.soilMoisture, data.waterLevel,
+             pumpControlIsRunning() ? "true" : "false", alarmManagerIsAlarmActive() ? "true" : "false",
+             configIsContinuousMode() ? "true" : "false", data.dhtOk ? "true" : "false",
+             (unsigned long)millis());
+    appendNumberOrNull(body, sizeof(body), "batteryVoltage", data.batteryVoltage > 0 ? data.batteryVoltage : NAN, false);
+    appendNumberOrNull(body, sizeof(body), "temperature", data.temperature, false);
+    appendNumberOrNull(body, sizeof(body), "humidity", data.humidity, true);
+    strncat(body, "}", sizeof(body) - strlen(body) - 1);
+    sendJson(200, body);
+}
+
+static void handlePump() {
+    if (!authorized()) return;
+
+    uint32_t durationMs = configGetPumpRunMillis();
+    const String payload = server->arg("plain");
+    if (payload.length() > 0) {
+        StaticJsonDocument<JSON_OBJECT_SIZE(1)> doc;
+        if (deserializeJson(doc, payload.c_str(), payload.length()) || !doc.is<JsonObject>()) {
+            sendJson(400, "{\"error\":\"invalid json\"}");
+            return;
+        }
+        durationMs = doc["durationMs"] | durationMs;
+    }
+    if (durationMs < LOCAL_PUMP_MIN_MS || durationMs > LOCAL_PUMP_MAX_MS) {
+        sendJson(422, "{\"error\":\"durationMs out of range\"}");
+        return;
+    }
+
+    // Antyspam jak przy komendach z backendu: trwające podlewanie nie jest przedłużane
+    if (pumpControlIsRunning()) {
+        sendJson(409, "{\"error\":\"pump already running\"}");
+        return;
+    }
+    if (!backendTasksRunPump(durationMs, sensorBusLatest().waterLevel)) {
+        sendJson(409, "{\"error\":\"no water\"}");
+        return;
+    }
+    schedulerNotify();  // Zadanie pompy i zdarzenie PUMP_START od razu
+
+    char body[64];
+    snprintf(body, sizeof(body), "{\"ok\":true,\"durationMs\":%lu}", (unsigned long)durationMs);
+    sendJson(200, body);
+}
+
+static void handleConfig() {
+    if (!authorized()) return;
+
+    const String payload = server->arg("plain");
+    if (!backendTasksApplyConfigJson(payload.c_str(), payload.length())) {
+        sendJson(400, "{\"error\":\"no known config fields\"}");
+        return;
+    }
+    if (configHandler != nullptr) configHandler();
+    sendJson(200, "{\"ok\":true}");
+}
+
+static void handleNotFound() {
+    sendJson(404, "{\"error\":\"not found\"}");
+}
+
+static bool localApiEnabled() {
+    return FLORA_LOCAL_API && configIsContinuousMode();
+}
+
+static bool tokenUsable() {
+    if (FLORA_LOCAL_API_TOKEN[0] == '\0' || strcmp(FLORA_LOCAL_API_TOKEN, "replace_me") == 0) return false;
+#ifdef FLORA_BACKEND_TOKEN
+    if (strcmp(FLORA_LOCAL_API_TOKEN, FLORA_BACKEND_TOKEN) == 0) return false;
+#endif
+    return true;
+}
+
+static void startServer() {
+    if (!tokenUsable()) {
+        if (!tokenMissingReported) {
+            Serial.println(F("[LocalApi] Brak osobnego tokenu (FLORA_LOCAL_API_TOKEN) - lokalne API wyłączone."));
+            tokenMissingReported = true;
+        }
+        return;
+    }
+
+    static const char* headerKeys[] = { "Authorization" };
+    server = new WebServer(FLORA_LOCAL_API_PORT);
+    server->collectHeaders(headerKeys, 1);
+    server->on("/api/status", HTTP_GET, handleStatus);
+    server->on("/api/pump", HTTP_POST, handlePump);
+    server->on("/api/config", HTTP_POST, handleConfig);
+    server->onNotFound(handleNotFound);
+    server->begin();
+    Serial.printf("[LocalApi] Lokalne API: http://%s:%u/api/status\n",
+                  WiFi.localIP().toString().c_str(), (unsigned)FLORA_LOCAL_API_PORT);
+}
+
+// Zwalnia port i pamięć serwera (wyjście z trybu ciągłego, utrata WiFi, portal konfiguracji)
+static void stopServer() {
+    server->stop();
+    delete server;
+    server = nullptr;
+    Serial.println(F("[LocalApi] Lokalne API zatrzymane."));
+}
+
+void localApiSetup(LocalApiConfigHandler onConfigApplied) {
+    configHandler = onConfigApplied;
+}
+
+void localApiProcess() {
+    lastProcessTime = millis();
+    // Portal WiFiManager zajmuje port 80, dopóki jest otwarty
+    const bool networkReady = wifiConnectionIsConnected() && !wifiConnectionPortalActive();
+
+    if (server != nullptr && (!localApiEnabled() || !networkReady)) {
+        stopServer();
+        return;
+    }
+    if (!localApiEnabled()) return;
+
+    if (server == nullptr) {
+        if (networkReady) startServer();
+        return;
+    }
+    server->handleClient();
+}
+
+uint32_t localApiNextMs() {
+    if (!localApiEnabled()) return server != nullptr ? 0 : SCHEDULER_IDLE;  // Serwer do zatrzymania
+    if (server == nullptr && tokenMissingReported) return SCHEDULER_IDLE;
+
+    const uint32_t intervalMs = server != nullptr ? LOCAL_API_POLL_INTERVAL_MS : LOCAL_API_WIFI_CHECK_MS;
+    const unsigned long elapsed = millis() - lastProcessTime;
+    return elapsed >= intervalMs ? 0 : (uint32_t)(intervalMs - elapsed);
+}
@@ -0,0 +1,91 @@
+// MeasurementPipeline.cpp
+#include "MeasurementPipeline.h"
+#include "SoilSensor.h"
+#include "WaterLevelSensor.h"
+#include "BatteryMonitor.h"
+#include "EnvironmentSensor.h"
+#include "Scheduler.h"
+#include <Arduino.h>
+
+// Kanały pomiarowe (bitmaska kanałów w toku)
+static const uint8_t CH_SOIL  = 0x01;
+static const uint8_t CH_WATER = 0x02;
+static const uint8_t CH_ENV   = 0x04;
+
+// Private variables
+static uint8_t           pendingChannels = 0;
+static SensorData        pipelineData;
+static MeasurementDoneFn doneCallback = nullptr;
+static unsigned long     startTime = 0;
+
+bool measurementPipelineStart(MeasurementDoneFn onDone) {
+    if (pendingChannels != 0) {
+        Serial.println(F("  [Pomiar] Pomiar już w toku - pomijam."));
+        return false;
+    }
+
+    pipelineData = SensorData();
+    doneCallback = onDone;
+    startTime = millis();
+
+    // Bateria jako pierwsza (~10 ms) - zanim sondy zaczną pobierać prąd
+    pipelineData.batteryVoltage = batteryMonitorReadVoltage();
+
+    // Najdłuższa stabilizacja (DHT) startuje najwcześniej, reszta mieści się w jej oknie
+    pendingChannels = CH_SOIL | CH_WATER | CH_ENV;
+    environmentSensorBeginRead();
+    soilSensorBeginRead();
+    waterLevelSensorBeginRead();
+
+    measurementPipelineUpdate();  // Kanały bez czasu stabilizacji kończą się od razu
+    return true;
+}
+
+void measurementPipelineUpdate() {
+    if (pendingChannels == 0) return;
+
+    if ((pendingChannels & CH_WATER) && waterLevelSensorPoll()) {
+        pipelineData.waterLevel = waterLevelSensorResult();
+        pendingChannels &= ~CH_WATER;
+    }
+    if ((pendingChannels & CH_SOIL) && soilSensorPoll()) {
+        pipelineData.soilMoisture = soilSensorResult();
+        pendingChannels &= ~CH_SOIL;
+    }
+    if ((pendingChannels & CH_ENV) && environmentSensorPoll()) {
+        float temperature, humidity;
+        pipelineData.dhtOk = environmentSensorResult(temperature, humidity);
+        pipelineData.temperature = temperature;
+        pipelineData.humidity = humidity;
+        pendingChannels &= ~CH_ENV;
+    }
+
+    if (pendingChannels == 0) {
+        Serial.printf("  [Pomiar] Wszystkie kanały gotowe po %lu ms.\n", millis() - startTime);
+        MeasurementDoneFn callback = doneCallback;
+        doneCallback = nullptr;
+        if (callback) callback(pipelineData);
+    }
+}
+
+uint32_t measurementPipelineNextUpdateMs() {
+    if (pendingChannels == 0) return SCHEDULER_IDLE;
+
+    uint32_t waitMs = SCHEDULER_IDLE;
+    if (pendingChannels & CH_WATER) waitMs = min(waitMs, waterLevelSensorNextPollMs());
+    if (pendingChannels & CH_SOIL)  waitMs = min(waitMs, soilSensorNextPollMs());
+    if (pendingChannels & CH_ENV)   waitMs = min(waitMs, environmentSensorNextPollMs());
+    return waitMs;
+}
+
+bool measurementPipelineIsRunning() {
+    return pendingChannels != 0;
+}
+
+void measurementPipelineAwait() {
+    while (pendingChannels != 0) {
+        uint32_t waitMs = measurementPipelineNextUpdateMs();
+        if (waitMs > 0) delay(waitMs);
+        measurementPipelineUpdate();
+    }
+}
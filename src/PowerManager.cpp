@@ -4,6 +4,9 @@
 #include <Arduino.h>
 #include <esp_sleep.h>
 #include <time.h>
+#include <sys/time.h>
+#include <esp_sntp.h>
+#include <esp_timer.h>
 
 #include "driver/rtc_io.h" // <-- Dodaj ten include dla funkcji rtc_gpio_...
 #include "soc/rtc.h"       // <-- Dodaj ten include dla esp_sleep_pd_config
@@ -12,11 +15,133 @@
 
 // Konfiguracja NTP
 const char* ntpServer = "pool.ntp.org";
-const long gmtOffset_sec = 3600;  // Strefa czasowa UTC+1 (dla Polski)
-const int daylightOffset_sec = 3600;  // Dodatkowa godzina dla czasu letniego
+const char* timeZone = "CET-1CEST,M3.5.0,M10.5.0/3";  // Strefa czasowa UTC+1 z czasem letnim (dla Polski)
+
+// Zegar: między synchronizacjami NTP płynie przez Deep Sleep z korektą dryftu RTC,
+// a nagłówek Date z odpowiedzi backendu poprawia go przy okazji każdego zapytania
+static const uint16_t NTP_SYNC_EVERY_WAKES = 24;
+static const int64_t  DATE_STEP_MIN_US = 2000000;              // Date ma rozdzielczość 1 s - mniejsze różnice pomijamy
+static const int64_t  DRIFT_BOUND_US = 5000000;                // Większa rozbieżność = NTP przy najbliższym połączeniu
+static const int64_t  DRIFT_WINDOW_MIN_US = 3600LL * 1000000;  // Tyle snu od synchronizacji, żeby zmierzyć dryft
+static const int32_t  MAX_DRIFT_PPM = 20000;                   // ±2% - więcej to raczej błąd pomiaru
+static const time_t   MIN_VALID_UNIX_TIME = 1700000000;
+
+// Rodzaj następnego wybudzenia timerem i odliczanie do wybudzenia pomiarowego - pamięć RTC przetrwa Deep Sleep
+RTC_DATA_ATTR static uint8_t  scheduledWake = POWER_WAKE_SCHEDULED;
+RTC_DATA_ATTR static uint64_t sensingRemainingUs = 0;  // 0 = pełny odstęp od następnego snu
+
+// Stan zegara (pamięć RTC)
+RTC_DATA_ATTR static int32_t  driftPpm = 0;            // Dryft zegara RTC w czasie snu: > 0 = spieszy się
+RTC_DATA_ATTR static int64_t  sleepStartedUs = 0;      // Czas systemowy zaśnięcia (0 = nieznany)
+RTC_DATA_ATTR static int64_t  sleptSinceSyncUs = 0;    // Czas snu od ostatniego wzorcowego czasu
+RTC_DATA_ATTR static uint16_t wakesSinceNtp = NTP_SYNC_EVERY_WAKES;
+RTC_DATA_ATTR static bool     ntpRequested = false;
+
+// Punkt odniesienia do liczenia przesunięcia po NTP (sntp ustawia zegar sam, zanim nas powiadomi)
+static int64_t     ntpReferenceUs = 0;
+static int64_t     ntpReferenceMonoUs = 0;
+static portMUX_TYPE clockMux = portMUX_INITIALIZER_UNLOCKED;
+
+static int64_t clockNowUs() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void clockSetUs(int64_t us) {
+    struct timeval tv;
+    tv.tv_sec = (time_t)(us / 1000000);
+    tv.tv_usec = (suseconds_t)(us % 1000000);
+    settimeofday(&tv, nullptr);
+}
+
+static bool clockValidUs(int64_t us) {
+    return us >= (int64_t)MIN_VALID_UNIX_TIME * 1000000;
+}
+
+// Wzorcowy czas (NTP albo serwer): przesunięcie narosłe w czasie snu to resztkowy dryft RTC
+static void onReferenceTime(int64_t referenceUs, int64_t localUs, const char* source) {
+    const int64_t offsetUs = referenceUs - localUs;   // > 0: zegar się spóźnia
+
+    portENTER_CRITICAL(&clockMux);
+    if (clockValidUs(localUs) && sleptSinceSyncUs >= DRIFT_WINDOW_MIN_US) {
+        const int64_t residualPpm = -offsetUs * 1000000 / sleptSinceSyncUs;
+        driftPpm = (int32_t)constrain(driftPpm + residualPpm / 2, (int64_t)-MAX_DRIFT_PPM, (int64_t)MAX_DRIFT_PPM);
+    }
+    sleptSinceSyncUs = 0;
+    const int32_t ppm = driftPpm;
+    portEXIT_CRITICAL(&clockMux);
+
+    Serial.printf("[Czas] %s: korekta zegara %+lld ms, dryft RTC %ld ppm.\n", source,
+                  (long long)(offsetUs / 1000), (long)ppm);
+}
+
+static void onNtpSync(struct timeval* tv) {
+    const int64_t referenceUs = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+    const int64_t monoUs = esp_timer_get_time();
+
+    portENTER_CRITICAL(&clockMux);
+    const int64_t localUs = ntpReferenceUs + (monoUs - ntpReferenceMonoUs);
+    ntpReferenceUs = referenceUs;   // SNTP odświeża czas cyklicznie - kolejne przesunięcie liczymy od teraz
+    ntpReferenceMonoUs = monoUs;
+    wakesSinceNtp = 0;
+    ntpRequested = false;
+    portEXIT_CRITICAL(&clockMux);
+
+    onReferenceTime(referenceUs, localUs, "NTP");
+}
+
+void powerManagerInitClock() {
+    setenv("TZ", timeZone, 1);
+    tzset();
+
+    // Po Deep Sleep zegar systemowy odmierzał czas zegarem RTC - cofamy jego zmierzony dryft
+    const bool fromDeepSleep = esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_UNDEFINED;
+    const int64_t now = clockNowUs();
+    if (fromDeepSleep && sleepStartedUs > 0 && clockValidUs(now) && now > sleepStartedUs) {
+        const int64_t sleptUs = now - sleepStartedUs;
+        const int64_t correctionUs = -sleptUs * driftPpm / 1000000;
+        if (correctionUs != 0) clockSetUs(now + correctionUs);
+        sleptSinceSyncUs += sleptUs;
+    }
+    sleepStartedUs = 0;
+    if (fromDeepSleep && wakesSinceNtp < UINT16_MAX) wakesSinceNtp++;
+}
+
+bool powerManagerTimeSyncDue() {
+    return !clockValidUs(clockNowUs()) || ntpRequested || wakesSinceNtp >= NTP_SYNC_EVERY_WAKES;
+}
+
+void powerManagerBeginTimeSync() {
+    portENTER_CRITICAL(&clockMux);
+    ntpReferenceUs = clockNowUs();
+    ntpReferenceMonoUs = esp_timer_get_time();
+    portEXIT_CRITICAL(&clockMux);
+
+    sntp_set_time_sync_notification_cb(onNtpSync);
+    configTzTime(timeZone, ntpServer);
+}
+
+void powerManagerApplyServerTime(time_t serverTime) {
+    if (serverTime < MIN_VALID_UNIX_TIME) return;
+
+    const int64_t localUs = clockNowUs();
+    const int64_t referenceUs = (int64_t)serverTime * 1000000 + 500000;  // Środek sekundy z nagłówka
+    const int64_t offsetUs = referenceUs - localUs;
+    const bool clockValid = clockValidUs(localUs);
+    if (clockValid && llabs(offsetUs) < DATE_STEP_MIN_US) return;  // W granicach rozdzielczości nagłówka
+
+    clockSetUs(clockNowUs() + offsetUs);
+    portENTER_CRITICAL(&clockMux);
+    ntpReferenceUs += offsetUs;   // Trwająca synchronizacja NTP nie policzy tego kroku jako dryftu
+    if (clockValid && llabs(offsetUs) > DRIFT_BOUND_US) ntpRequested = true;
+    portEXIT_CRITICAL(&clockMux);
+
+    onReferenceTime(referenceUs, localUs, "Serwer");
+}
 
 bool powerManagerSyncTime() {
-    configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
+    powerManagerBeginTimeSync();
     
     // Poczekaj na synchronizację czasu
     Serial.println("Synchronizuję czas z serwerem NTP...");
@@ -89,9 +214,47 @@ uint64_t powerManagerGetTimeToNextMeasurement() {
     return (uint64_t)secondsToToday * 1000000ULL;
 }
 
-void powerManagerGoToDeepSleep() {
+PowerWakeKind powerManagerWakeKind() {
+    if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_TIMER) return POWER_WAKE_SCHEDULED;
+    return (PowerWakeKind)scheduledWake;
+}
+
+void powerManagerGoToDeepSleep(uint32_t sensingIntervalSec, uint32_t listenIntervalSec) {
     // Oblicz czas do następnego pomiaru
     uint64_t sleepDurationUs = powerManagerGetTimeToNextMeasurement();
+    scheduledWake = POWER_WAKE_SCHEDULED;
+
+    // Wybudzenie pomiarowe wcześniej niż zaplanowany pomiar z synchronizacją?
+    const uint64_t sensingUs = (uint64_t)sensingIntervalSec * 1000000ULL;
+    if (sensingRemainingUs == 0 || sensingRemainingUs > sensingUs) {
+        sensingRemainingUs = sensingUs;
+    }
+    if (sensingRemainingUs > 0 && sensingRemainingUs < sleepDurationUs) {
+        sleepDurationUs = sensingRemainingUs;
+        scheduledWake = POWER_WAKE_SENSING;
+    }
+
+    // Nasłuch komend jeszcze wcześniej?
+    const uint64_t listenUs = (uint64_t)listenIntervalSec * 1000000ULL;
+    if (listenUs > 0 && listenUs < sleepDurationUs) {
+        sleepDurationUs = listenUs;
+        scheduledWake = POWER_WAKE_LISTEN;
+    }
+
+    // Po wybudzeniu nasłuchu pomiar wypada o tyle wcześniej; po każdym innym odliczanie zaczyna się od nowa
+    const bool carryOver = scheduledWake == POWER_WAKE_LISTEN && sensingRemainingUs > sleepDurationUs;
+    sensingRemainingUs = carryOver ? sensingRemainingUs - sleepDurationUs : 0;
+
+    if (scheduledWake == POWER_WAKE_SENSING) {
+        Serial.println("Następne wybudzenie tylko pomiarowe (WiFi wyłączone).");
+    } else if (scheduledWake == POWER_WAKE_LISTEN) {
+        Serial.println("Następne wybudzenie tylko na sprawdzenie komend (czujniki wyłączone).");
+    }
+
+    // Spieszący się zegar RTC (ppm > 0) odmierzyłby zadany czas za wcześnie
+    const int64_t driftUs = (int64_t)sleepDurationUs * driftPpm / 1000000;
+    sleepDurationUs = (uint64_t)max((int64_t)sleepDurationUs + driftUs, (int64_t)1000000);
+    sleepStartedUs = clockValidUs(clockNowUs()) ? clockNowUs() : 0;
 
     Serial.printf("Przechodzę w Deep Sleep na %llu sekund...\n", sleepDurationUs / 1000000ULL);
     Serial.flush(); // Upewnij się, że Serial został wysłany
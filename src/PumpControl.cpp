@@ -3,6 +3,8 @@
 #include "DeviceConfig.h"
 #include <Arduino.h>
 #include "BlynkManager.h"
+#include "Scheduler.h"
+#include <esp_timer.h>
 
 // LEDC (PWM) configuration
 const int PUMP_LEDC_CHANNEL = 0;    // LEDC channel (0-15)
@@ -14,6 +16,24 @@ static uint8_t pumpPin;
 static bool isPumpOn = false;
 static unsigned long pumpStartTime = 0;
 static uint32_t pumpTargetDuration = 0;
+// Sprzętowe wyłączenie pompy niezależne od pętli głównej (np. gdy setup() czeka na sieć
+// po decyzji o podlaniu). Księgowość stanu nadal robi pumpControlUpdate().
+static esp_timer_handle_t cutoffTimer = nullptr;
+
+static void pumpCutoffCallback(void* arg) {
+    (void)arg;
+    ledcWrite(PUMP_LEDC_CHANNEL, 0);
+}
+
+static void armCutoffTimer(uint32_t durationMillis) {
+    if (cutoffTimer == nullptr) return;
+    esp_timer_stop(cutoffTimer);
+    esp_timer_start_once(cutoffTimer, (uint64_t)durationMillis * 1000ULL);
+}
+
+static void disarmCutoffTimer() {
+    if (cutoffTimer != nullptr) esp_timer_stop(cutoffTimer);
+}
 
 void pumpControlSetup() {
     pumpPin = configGetPumpPin();
@@ -27,6 +47,16 @@ void pumpControlSetup() {
         ledcWrite(PUMP_LEDC_CHANNEL, 0);
         isPumpOn = false;
 
+        if (cutoffTimer == nullptr) {
+            esp_timer_create_args_t timerArgs = {};
+            timerArgs.callback = pumpCutoffCallback;
+            timerArgs.name = "pump_cutoff";
+            if (esp_timer_create(&timerArgs, &cutoffTimer) != ESP_OK) {
+                cutoffTimer = nullptr;
+                Serial.println("  [Pump] WARNING: Cutoff timer unavailable, relying on pumpControlUpdate().");
+            }
+        }
+
         // Log configuration info
         Serial.printf("  [Pump] Configured PWM control pin: %d (LEDC Channel: %d, Freq: %d Hz, Res: %d bit)\n",
                       pumpPin, PUMP_LEDC_CHANNEL, PUMP_LEDC_FREQ, PUMP_LEDC_RESOLUTION);
@@ -83,6 +113,7 @@ void pumpControlActivateIfNeeded(int currentSoilMoisture, int currentWaterLevel)
         isPumpOn = true;
         pumpStartTime = millis();
         pumpTargetDuration = currentPumpRunMillis;
+        armCutoffTimer(pumpTargetDuration);
         blynkUpdatePumpStatus(isPumpOn);
         Serial.println("  [Pump] Pump started (auto).");
     } else {
@@ -112,6 +143,7 @@ void pumpControlManualTurnOn(uint32_t durationMillis) {
     isPumpOn = true;
     pumpStartTime = millis();
     pumpTargetDuration = durationMillis;
+    armCutoffTimer(pumpTargetDuration);
     blynkUpdatePumpStatus(isPumpOn);
 }
 
@@ -125,6 +157,7 @@ void pumpControlManualTurnOff() {
         Serial.println("  [Pump] Manual immediate pump shutdown...");
         // Turn off pump using PWM (duty cycle = 0)
         ledcWrite(PUMP_LEDC_CHANNEL, 0);
+        disarmCutoffTimer();
         isPumpOn = false;
         pumpTargetDuration = 0;
         blynkUpdatePumpStatus(isPumpOn);
@@ -142,9 +175,16 @@ void pumpControlUpdate() {
         Serial.printf("  [Pump] Run time (%u ms) elapsed. Turning off pump.\n", pumpTargetDuration);
         // Turn off pump using PWM (duty cycle = 0)
         ledcWrite(PUMP_LEDC_CHANNEL, 0);
+        disarmCutoffTimer();
         isPumpOn = false;
         pumpTargetDuration = 0;
         blynkUpdatePumpStatus(isPumpOn);
         Serial.println("  [Pump] Pump stopped (auto-off after timeout).");
     }
+}
+
+uint32_t pumpControlNextUpdateMs() {
+    if (!isPumpOn) return SCHEDULER_IDLE;
+    unsigned long elapsed = millis() - pumpStartTime;
+    return (elapsed >= pumpTargetDuration) ? 0 : (uint32_t)(pumpTargetDuration - elapsed);
 }
\ No newline at end of file
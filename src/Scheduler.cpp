@@ -0,0 +1,102 @@
+// Scheduler.cpp
+#include "Scheduler.h"
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Maksymalna liczba zadań - tablica statyczna, bez alokacji
+static const int MAX_TASKS = 16;
+// Górny limit pojedynczego blokowania (pdMS_TO_TICKS przepełnia się dla bardzo dużych wartości)
+static const uint32_t MAX_WAIT_MS = 3600000UL;
+
+struct SchedulerTask {
+    const char*     name;
+    SchedulerRunFn  run;
+    SchedulerNextFn next;
+};
+
+// Private variables
+static SchedulerTask tasks[MAX_TASKS];
+static int           taskCount = 0;
+static TaskHandle_t  ownerTask = nullptr;      // Zadanie wywołujące schedulerRun() (loopTask)
+static volatile uint32_t pendingMask = 0;      // Zadania wyzwolone przez schedulerTrigger()
+static portMUX_TYPE  pendingMux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t      wakeCount = 0;
+
+void schedulerSetup() {
+    ownerTask = xTaskGetCurrentTaskHandle();
+    taskCount = 0;
+    pendingMask = 0;
+    wakeCount = 0;
+    Serial.println("  [Scheduler] Gotowy.");
+}
+
+int schedulerAdd(const char* name, SchedulerRunFn run, SchedulerNextFn next) {
+    if (taskCount >= MAX_TASKS || run == nullptr || next == nullptr) {
+        Serial.printf("  [Scheduler] BŁĄD: Nie można dodać zadania '%s'!\n", name);
+        return -1;
+    }
+    tasks[taskCount] = { name, run, next };
+    // Nowe zadanie wykonuje się raz w najbliższym przebiegu, żeby ustalić swój stan
+    portENTER_CRITICAL(&pendingMux);
+    pendingMask |= (1UL << taskCount);
+    portEXIT_CRITICAL(&pendingMux);
+    return taskCount++;
+}
+
+void schedulerTrigger(int taskId) {
+    if (taskId < 0 || taskId >= taskCount) return;
+    portENTER_CRITICAL(&pendingMux);
+    pendingMask |= (1UL << taskId);
+    portEXIT_CRITICAL(&pendingMux);
+    schedulerNotify();
+}
+
+void schedulerNotify() {
+    if (ownerTask != nullptr && xTaskGetCurrentTaskHandle() != ownerTask) {
+        xTaskNotifyGive(ownerTask);
+    }
+}
+
+void IRAM_ATTR schedulerNotifyFromISR() {
+    if (ownerTask == nullptr) return;
+    BaseType_t higherPriorityWoken = pdFALSE;
+    vTaskNotifyGiveFromISR(ownerTask, &higherPriorityWoken);
+    portYIELD_FROM_ISR(higherPriorityWoken);
+}
+
+void schedulerRun() {
+    portENTER_CRITICAL(&pendingMux);
+    uint32_t triggered = pendingMask;
+    pendingMask = 0;
+    portEXIT_CRITICAL(&pendingMux);
+
+    // --- Wykonaj zadania wyzwolone lub na czasie ---
+    for (int i = 0; i < taskCount; i++) {
+        if ((triggered & (1UL << i)) || tasks[i].next() == 0) {
+            tasks[i].run();
+        }
+    }
+
+    // --- Najbliższy termin (odpytujemy po przebiegu, bo zadania mogły zmienić stan innych modułów) ---
+    uint32_t waitMs = SCHEDULER_IDLE;
+    for (int i = 0; i < taskCount; i++) {
+        uint32_t next = tasks[i].next();
+        if (next < waitMs) waitMs = next;
+    }
+
+    portENTER_CRITICAL(&pendingMux);
+    if (pendingMask != 0) waitMs = 0;
+    portEXIT_CRITICAL(&pendingMux);
+
+    if (waitMs == 0) return;
+
+    TickType_t ticks = (waitMs == SCHEDULER_IDLE) ? portMAX_DELAY : pdMS_TO_TICKS(min(waitMs, MAX_WAIT_MS));
+    if (ticks == 0) ticks = 1;
+    ulTaskNotifyTake(pdTRUE, ticks);
+    wakeCount++;
+}
+
+uint32_t schedulerGetWakeCount() {
+    return wakeCount;
+}
@@ -0,0 +1,43 @@
+// SensorBus.cpp
+#include "SensorBus.h"
+#include <Arduino.h>
+
+static const int MAX_SUBSCRIBERS = 8;
+
+struct SensorBusSubscriber {
+    const char*      name;
+    SensorBusHandler handler;
+};
+
+// Private variables
+static SensorBusSubscriber subscribers[MAX_SUBSCRIBERS];
+static int        subscriberCount = 0;
+static SensorData latestData;
+static uint32_t   latestVersion = 0;
+
+bool sensorBusSubscribe(const char* name, SensorBusHandler handler) {
+    if (handler == nullptr || subscriberCount >= MAX_SUBSCRIBERS) {
+        Serial.printf("  [SensorBus] BŁĄD: Nie można zarejestrować odbiorcy '%s'!\n", name);
+        return false;
+    }
+    subscribers[subscriberCount++] = { name, handler };
+    return true;
+}
+
+uint32_t sensorBusPublish(const SensorData& data) {
+    latestData = data;
+    latestVersion++;
+
+    for (int i = 0; i < subscriberCount; i++) {
+        subscribers[i].handler(latestData, latestVersion);
+    }
+    return latestVersion;
+}
+
+const SensorData& sensorBusLatest() {
+    return latestData;
+}
+
+uint32_t sensorBusVersion() {
+    return latestVersion;
+}
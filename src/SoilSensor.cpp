@@ -7,6 +7,22 @@ static int adcDry;
 static int adcWet;
 static int vccPin; // Przechowuje pin VCC (-1 jeśli nieużywany)
 
+// Parametry odczytu
+static const unsigned long SOIL_SETTLE_MS = 500;   // Czas na stabilizację po włączeniu VCC
+static const int           SOIL_SAMPLES = 5;       // Liczba uśrednianych próbek
+static const unsigned long SOIL_SAMPLE_INTERVAL_MS = 50;
+
+// Stan odczytu nieblokującego
+enum SoilReadState { SOIL_IDLE, SOIL_SAMPLING, SOIL_DONE };
+static SoilReadState readState = SOIL_IDLE;
+static unsigned long nextSampleTime = 0;
+static int  samplesTaken = 0;
+static long totalValue = 0;
+static int  lastPercent = -1;
+
+static int convertToPercent(int sensorValue);
+
+
 void soilSensorSetup() {
     // Pobierz konfigurację z modułu DeviceConfig
     sensorPin = configGetSoilPin();
@@ -23,30 +39,64 @@ void soilSensorSetup() {
      Serial.printf("  [Wilgotność] Skonfigurowano pin ADC: %d (Kalibracja: Sucho=%d, Mokro=%d)\n", sensorPin, adcDry, adcWet);
 }
 
-int soilSensorReadPercent() {
-    int sensorValue = 0;
-    int moisturePercent = -1; // Domyślnie błąd (-1), aby wskazać problem z odczytem lub kalibracją
+void soilSensorBeginRead() {
+    samplesTaken = 0;
+    totalValue = 0;
+    nextSampleTime = millis();
+    readState = SOIL_SAMPLING;
 
-    // Włącz zasilanie, jeśli VCC Pin jest skonfigurowany
+    // Włącz zasilanie, jeśli VCC Pin jest skonfigurowany - próbkujemy dopiero po stabilizacji
     if (vccPin != -1) {
         digitalWrite(vccPin, HIGH);
-        delay(500); // Czas na stabilizację
+        nextSampleTime += SOIL_SETTLE_MS;
+    }
+}
+
+bool soilSensorPoll() {
+    if (readState != SOIL_SAMPLING) {
+        return readState == SOIL_DONE;
+    }
+    if ((long)(millis() - nextSampleTime) < 0) {
+        return false;  // Jeszcze nie czas na kolejną próbkę
     }
 
-    // Uśrednianie odczytów
-    long totalValue = 0;
-    int samples = 5; // Możesz dostosować liczbę próbek
-    for (int i = 0; i < samples; i++) {
-        totalValue += analogRead(sensorPin);
-        delay(50); // Krótka przerwa między odczytami
+    totalValue += analogRead(sensorPin);
+    if (++samplesTaken < SOIL_SAMPLES) {
+        nextSampleTime = millis() + SOIL_SAMPLE_INTERVAL_MS;  // Krótka przerwa między odczytami
+        return false;
     }
-    sensorValue = totalValue / samples;
 
     // Wyłącz zasilanie, jeśli VCC Pin jest skonfigurowany
     if (vccPin != -1) {
         digitalWrite(vccPin, LOW);
     }
 
+    lastPercent = convertToPercent(totalValue / SOIL_SAMPLES);
+    readState = SOIL_DONE;
+    return true;
+}
+
+uint32_t soilSensorNextPollMs() {
+    if (readState != SOIL_SAMPLING) return 0;
+    long remaining = (long)(nextSampleTime - millis());
+    return remaining > 0 ? (uint32_t)remaining : 0;
+}
+
+int soilSensorResult() {
+    return lastPercent;
+}
+
+int soilSensorReadPercent() {
+    soilSensorBeginRead();
+    while (!soilSensorPoll()) {
+        delay(soilSensorNextPollMs());
+    }
+    return soilSensorResult();
+}
+
+static int convertToPercent(int sensorValue) {
+    int moisturePercent = -1; // Domyślnie błąd (-1), aby wskazać problem z odczytem lub kalibracją
+
     Serial.printf("  [Wilgotność] Surowy odczyt ADC (Pin %d): %d\n", sensorPin, sensorValue);
 
     // --- POPRAWIONA LOGIKA PRZELICZANIA ---
@@ -80,4 +130,4 @@ int soilSensorReadPercent() {
     Serial.printf("  [Wilgotność] Obliczony procent: %d%%\n", moisturePercent);
 
     return moisturePercent;
-}
\ No newline at end of file
+}
@@ -0,0 +1,72 @@
+// TelemetryHistory.cpp
+#include "TelemetryHistory.h"
+#include <Arduino.h>
+
+// Private variables (pamięć RTC - zerowana tylko przy zimnym starcie, nie po Deep Sleep)
+RTC_DATA_ATTR static TelemetryRecord records[TELEMETRY_HISTORY_CAPACITY];
+RTC_DATA_ATTR static uint16_t        head = 0;      // Indeks najstarszego rekordu
+RTC_DATA_ATTR static uint16_t        count = 0;
+RTC_DATA_ATTR static uint32_t        nextSeq = 1;
+static portMUX_TYPE                  historyMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Uszkodzony stan (np. reset w trakcie zapisu) - zaczynamy od pustego bufora
+static void validateLocked() {
+    if (head >= TELEMETRY_HISTORY_CAPACITY || count > TELEMETRY_HISTORY_CAPACITY) {
+        head = 0;
+        count = 0;
+    }
+}
+
+uint32_t telemetryHistoryPush(const TelemetryRecord& record) {
+    bool overwritten = false;
+
+    portENTER_CRITICAL(&historyMux);
+    validateLocked();
+    if (count == TELEMETRY_HISTORY_CAPACITY) {
+        head = (head + 1) % TELEMETRY_HISTORY_CAPACITY;
+        count--;
+        overwritten = true;
+    }
+    TelemetryRecord& slot = records[(head + count) % TELEMETRY_HISTORY_CAPACITY];
+    slot = record;
+    slot.seq = nextSeq++;
+    count++;
+    const uint32_t seq = slot.seq;
+    const size_t stored = count;
+    portEXIT_CRITICAL(&historyMux);
+
+    if (overwritten) {
+        Serial.println(F("[History] Bufor pełny - nadpisano najstarszy pomiar."));
+    }
+    Serial.printf("[History] Pomiar #%u zapisany w RTC (%u w buforze).\n", (unsigned)seq, (unsigned)stored);
+    return seq;
+}
+
+size_t telemetryHistoryPeek(TelemetryRecord* out, size_t maxRecords) {
+    portENTER_CRITICAL(&historyMux);
+    validateLocked();
+    const size_t n = min((size_t)count, maxRecords);
+    for (size_t i = 0; i < n; i++) {
+        out[i] = records[(head + i) % TELEMETRY_HISTORY_CAPACITY];
+    }
+    portEXIT_CRITICAL(&historyMux);
+    return n;
+}
+
+void telemetryHistoryAck(uint32_t lastSeq) {
+    portENTER_CRITICAL(&historyMux);
+    validateLocked();
+    while (count > 0 && (int32_t)(records[head].seq - lastSeq) <= 0) {
+        head = (head + 1) % TELEMETRY_HISTORY_CAPACITY;
+        count--;
+    }
+    portEXIT_CRITICAL(&historyMux);
+}
+
+size_t telemetryHistoryCount() {
+    portENTER_CRITICAL(&historyMux);
+    validateLocked();
+    const size_t n = count;
+    portEXIT_CRITICAL(&historyMux);
+    return n;
+}
@@ -28,31 +28,75 @@ void waterLevelSensorSetup() {
     pinMode(groundPin, INPUT);
 }
 
-int waterLevelSensorReadLevel() {
-    uint8_t resultLevel = 0;
-    sensorThreshold = configGetWaterLevelThreshold();
+// Stan odczytu nieblokującego (sondy sprawdzane od najwyższej, każda wymaga sensorWaitingTime)
+static int8_t        probeIdx = -1;          // Aktualnie zasilana sonda (-1 = brak)
+static unsigned long probeReadTime = 0;      // Kiedy można odczytać ADC dla aktualnej sondy
+static bool          readDone = true;
+static uint8_t       resultLevel = 0;
 
-    // Iterujemy od ostatniego indeksu (wysoki pin) do 0
-    for (int8_t idx = NUM_WATER_LEVELS - 1; idx >= 0; --idx) {
+// Zasila następną (niższą) skonfigurowaną sondę; false jeśli nie ma już sond do sprawdzenia
+static bool driveNextProbe(int8_t fromIdx) {
+    for (int8_t idx = fromIdx; idx >= 0; --idx) {
         uint8_t pin = configGetWaterLevelPin(idx + 1);
         if (pin == 255) continue;
 
         pinMode(pin, OUTPUT);
         digitalWrite(pin, HIGH);
-        delay(sensorWaitingTime);
+        probeIdx = idx;
+        probeReadTime = millis() + sensorWaitingTime;
+        return true;
+    }
+    probeIdx = -1;
+    return false;
+}
+
+static void finishRead(uint8_t level) {
+    resultLevel = level;
+    readDone = true;
+    Serial.printf(">> Poziom wody: %d\n", resultLevel);
+}
+
+void waterLevelSensorBeginRead() {
+    sensorThreshold = configGetWaterLevelThreshold();
+    readDone = false;
+    // Iterujemy od ostatniego indeksu (wysoki pin) do 0
+    if (!driveNextProbe(NUM_WATER_LEVELS - 1)) {
+        finishRead(0);
+    }
+}
 
-        uint16_t adc = analogRead(configGetWaterLevelGroundPin());
+bool waterLevelSensorPoll() {
+    if (readDone) return true;
+    if ((long)(millis() - probeReadTime) < 0) return false;
 
-        pinMode(pin, INPUT);
-        Serial.printf("[Poz%d pin=%d] ADC=%u\n", idx+1, pin, adc);
+    uint8_t pin = configGetWaterLevelPin(probeIdx + 1);
+    uint16_t adc = analogRead(configGetWaterLevelGroundPin());
 
-        if (adc > sensorThreshold) {
-            resultLevel = idx + 1;
-            break;
-        }
+    pinMode(pin, INPUT);
+    Serial.printf("[Poz%d pin=%d] ADC=%u\n", probeIdx + 1, pin, adc);
+
+    if (adc > sensorThreshold) {
+        finishRead(probeIdx + 1);
+    } else if (!driveNextProbe(probeIdx - 1)) {
+        finishRead(0);
     }
+    return readDone;
+}
 
-    Serial.printf(">> Poziom wody: %d\n", resultLevel);
+uint32_t waterLevelSensorNextPollMs() {
+    if (readDone) return 0;
+    long remaining = (long)(probeReadTime - millis());
+    return remaining > 0 ? (uint32_t)remaining : 0;
+}
+
+int waterLevelSensorResult() {
     return resultLevel;
 }
 
+int waterLevelSensorReadLevel() {
+    waterLevelSensorBeginRead();
+    while (!waterLevelSensorPoll()) {
+        delay(waterLevelSensorNextPollMs());
+    }
+    return waterLevelSensorResult();
+}
@@ -0,0 +1,284 @@
+// WiFiConnection.cpp
+#include "WiFiConnection.h"
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiManager.h>
+#include "Scheduler.h"
+#include <esp_wifi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <time.h>
+
+#if __has_include("secrets.h")
+#include "secrets.h"
+#endif
+
+static const EventBits_t GOT_IP_BIT = BIT0;
+static const EventBits_t FAST_FAILED_BIT = BIT1;
+// Co ile obsługujemy portal (DNS/HTTP) - tylko gdy portal jest otwarty
+static const uint32_t PORTAL_PROCESS_INTERVAL_MS = 20;
+// Szybkie łączenie (znany AP i kanał) trwa zwykle kilkaset ms - po tym czasie pełne łączenie
+static const uint32_t FAST_CONNECT_TIMEOUT_MS = 2000;
+// Dzierżawę DHCP używamy ponownie (bez DHCP) tylko przez tyle od jej uzyskania. Czasu dzierżawy
+// nadanego przez router nie znamy, więc zapas: połowa najkrótszych spotykanych dzierżaw (1 h, np.
+// hotspot w telefonie). Router z dłuższymi dzierżawami: FLORA_LEASE_REUSE_SEC w secrets.h.
+#ifndef FLORA_LEASE_REUSE_SEC
+#define FLORA_LEASE_REUSE_SEC (30 * 60)
+#endif
+static const time_t   LEASE_REUSE_MAX_SEC = FLORA_LEASE_REUSE_SEC;
+// Czas systemowy wcześniejszy niż to = zegar jeszcze nie zsynchronizowany
+static const time_t   MIN_VALID_UNIX_TIME = 1700000000;
+
+// Ostatnie udane połączenie - pamięć RTC przetrwa Deep Sleep
+struct FastConnectCache {
+    uint32_t credentialsHash;  // 0 = brak wpisu; zmiana sieci/hasła w NVS unieważnia wpis
+    uint8_t  bssid[6];
+    uint8_t  channel;
+    uint32_t ip;               // Dzierżawa DHCP (0 = brak)
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+    time_t   leaseAt;          // Czas uzyskania dzierżawy, 0 = zegar nie był ustawiony
+};
+
+// Private variables
+RTC_DATA_ATTR static FastConnectCache fastCache;
+static EventGroupHandle_t wifiEvents = nullptr;
+static unsigned long beginTime = 0;
+static bool associationStarted = false;
+static volatile bool fastAttempt = false;    // Trwa próba szybkiego łączenia
+static volatile bool staticIpApplied = false; // Adres nie pochodzi z DHCP (dzierżawa z RTC albo stały)
+static uint32_t credentialsHash = 0;
+static WiFiManager* portal = nullptr;        // Tworzony tylko na czas pracy portalu
+static unsigned long lastPortalProcessTime = 0;
+
+// FNV-1a z nazwy i hasła sieci
+static uint32_t hashCredentials(const wifi_sta_config_t& sta) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < sizeof(sta.ssid) && sta.ssid[i]; i++) hash = (hash ^ sta.ssid[i]) * 16777619u;
+    hash = (hash ^ 0xFF) * 16777619u;
+    for (size_t i = 0; i < sizeof(sta.password) && sta.password[i]; i++) hash = (hash ^ sta.password[i]) * 16777619u;
+    return hash == 0 ? 1 : hash;
+}
+
+static bool loadStaConfig(wifi_config_t& conf) {
+    if (esp_wifi_get_config(WIFI_IF_STA, &conf) != ESP_OK) return false;
+    return conf.sta.ssid[0] != 0;
+}
+
+static bool leaseReusable() {
+    const time_t now = time(nullptr);
+    return fastCache.ip != 0 && fastCache.leaseAt >= MIN_VALID_UNIX_TIME &&
+           now >= fastCache.leaseAt && now - fastCache.leaseAt < LEASE_REUSE_MAX_SEC;
+}
+
+// Stały adres z secrets.h, dzierżawa z RTC albo DHCP
+static void applyIpConfig(bool reuseLease) {
+#if defined(FLORA_STATIC_IP) && defined(FLORA_STATIC_GATEWAY) && defined(FLORA_STATIC_SUBNET)
+    (void)reuseLease;
+    IPAddress ip, gateway, subnet, dns;
+    ip.fromString(FLORA_STATIC_IP);
+    gateway.fromString(FLORA_STATIC_GATEWAY);
+    subnet.fromString(FLORA_STATIC_SUBNET);
+#ifdef FLORA_STATIC_DNS
+    dns.fromString(FLORA_STATIC_DNS);
+#else
+    dns = gateway;
+#endif
+    WiFi.config(ip, gateway, subnet, dns);
+    staticIpApplied = true;
+#else
+    if (reuseLease) {
+        WiFi.config(IPAddress(fastCache.ip), IPAddress(fastCache.gateway),
+                    IPAddress(fastCache.subnet), IPAddress(fastCache.dns));
+        staticIpApplied = true;
+    } else if (staticIpApplied) {
+        WiFi.config(IPAddress(), IPAddress(), IPAddress());  // Z powrotem DHCP
+        staticIpApplied = false;
+    }
+#endif
+}
+
+static void rememberConnection() {
+    const uint8_t* bssid = WiFi.BSSID();
+    if (bssid == nullptr || credentialsHash == 0) return;
+
+    if (fastCache.credentialsHash != credentialsHash) {
+        fastCache.ip = 0;
+        fastCache.leaseAt = 0;
+    }
+    fastCache.credentialsHash = credentialsHash;
+    memcpy(fastCache.bssid, bssid, sizeof(fastCache.bssid));
+    fastCache.channel = (uint8_t)WiFi.channel();
+
+    // Dzierżawę zapisujemy tylko świeżo z DHCP - ponowne użycie jej nie przedłuża
+    if (!staticIpApplied) {
+        const time_t now = time(nullptr);
+        fastCache.ip      = WiFi.localIP();
+        fastCache.gateway = WiFi.gatewayIP();
+        fastCache.subnet  = WiFi.subnetMask();
+        fastCache.dns     = WiFi.dnsIP();
+        fastCache.leaseAt = now >= MIN_VALID_UNIX_TIME ? now : 0;
+    }
+}
+
+static void onWiFiEvent(WiFiEvent_t event) {
+    if (wifiEvents == nullptr) return;
+    if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+        rememberConnection();
+        fastAttempt = false;
+        xEventGroupSetBits(wifiEvents, GOT_IP_BIT);
+    } else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED) {
+        xEventGroupClearBits(wifiEvents, GOT_IP_BIT);
+        if (fastAttempt) xEventGroupSetBits(wifiEvents, FAST_FAILED_BIT);
+    }
+}
+
+// Pełne łączenie: skan wszystkich kanałów i DHCP (jawne dane sieci zdejmują przypięty AP/kanał)
+static void beginFullConnect(const wifi_config_t& conf) {
+    char ssid[sizeof(conf.sta.ssid) + 1] = {0};
+    char password[sizeof(conf.sta.password) + 1] = {0};
+    memcpy(ssid, conf.sta.ssid, sizeof(conf.sta.ssid));
+    memcpy(password, conf.sta.password, sizeof(conf.sta.password));
+
+    applyIpConfig(false);
+    WiFi.begin(ssid, password);
+}
+
+// Szybkie łączenie: bez skanu (znany AP i kanał) i - gdy dzierżawa jest świeża - bez DHCP
+static void beginFastConnect(const wifi_config_t& conf) {
+    char ssid[sizeof(conf.sta.ssid) + 1] = {0};
+    char password[sizeof(conf.sta.password) + 1] = {0};
+    memcpy(ssid, conf.sta.ssid, sizeof(conf.sta.ssid));
+    memcpy(password, conf.sta.password, sizeof(conf.sta.password));
+
+    const bool reuseLease = leaseReusable();
+    applyIpConfig(reuseLease);
+    fastAttempt = true;
+    WiFi.begin(ssid, password, fastCache.channel, fastCache.bssid);
+    Serial.printf("[WiFi] Szybkie łączenie: kanał %u, %s.\n", fastCache.channel,
+                  staticIpApplied ? "adres bez DHCP" : "DHCP");
+}
+
+// Szybka próba zawiodła (inny AP/kanał, odrzucone połączenie) - wpis z RTC jest nieaktualny
+static void fallBackToFullConnect() {
+    fastAttempt = false;
+    fastCache.credentialsHash = 0;
+    xEventGroupClearBits(wifiEvents, FAST_FAILED_BIT);
+    Serial.println(F("[WiFi] Szybkie łączenie nieudane - pełne łączenie ze skanem."));
+
+    wifi_config_t conf;
+    if (!loadStaConfig(conf)) return;
+    WiFi.disconnect();
+    beginFullConnect(conf);
+}
+
+// Czeka na bity, najdłużej do untilMs liczonego od wifiConnectionBegin()
+static EventBits_t waitSinceBegin(EventBits_t bits, uint32_t untilMs) {
+    const unsigned long elapsed = millis() - beginTime;
+    if (elapsed >= untilMs) return xEventGroupGetBits(wifiEvents) & bits;
+    return xEventGroupWaitBits(wifiEvents, bits, pdFALSE, pdFALSE, pdMS_TO_TICKS(untilMs - elapsed)) & bits;
+}
+
+bool wifiConnectionHasCredentials() {
+    wifi_config_t conf;
+    return loadStaConfig(conf);
+}
+
+bool wifiConnectionBegin() {
+    if (wifiEvents == nullptr) {
+        wifiEvents = xEventGroupCreate();
+        WiFi.onEvent(onWiFiEvent, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+        WiFi.onEvent(onWiFiEvent, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+    }
+
+    WiFi.mode(WIFI_STA);  // Inicjalizuje sterownik - dopiero wtedy widać zapisaną konfigurację
+    beginTime = millis();
+
+    wifi_config_t conf;
+    if (!loadStaConfig(conf)) {
+        Serial.println(F("[WiFi] Brak zapisanej sieci - połączenie dopiero przez portal."));
+        associationStarted = false;
+        return false;
+    }
+
+    // Łączy z siecią zapisaną w NVS (przez WiFiManager). Asocjacja, DHCP itd. toczą się
+    // w zadaniu sterownika WiFi, a my w tym czasie mierzymy.
+    credentialsHash = hashCredentials(conf.sta);
+    xEventGroupClearBits(wifiEvents, FAST_FAILED_BIT);
+    if (fastCache.credentialsHash == credentialsHash && fastCache.channel != 0) {
+        beginFastConnect(conf);
+    } else {
+        Serial.println(F("[WiFi] Rozpoczynam łączenie z zapisaną siecią (w tle)..."));
+        beginFullConnect(conf);
+    }
+    associationStarted = true;
+    return true;
+}
+
+bool wifiConnectionAwait(uint32_t timeoutMs) {
+    if (wifiConnectionIsConnected()) return true;
+    if (!associationStarted || wifiEvents == nullptr) return false;
+
+    // Najpierw krótko na szybkie łączenie, potem reszta czasu na pełne
+    if (fastAttempt) {
+        const EventBits_t bits = waitSinceBegin(GOT_IP_BIT | FAST_FAILED_BIT,
+                                                min(FAST_CONNECT_TIMEOUT_MS, timeoutMs));
+        if (!(bits & GOT_IP_BIT) && fastAttempt && !wifiConnectionIsConnected()) {
+            fallBackToFullConnect();
+        }
+    }
+
+    if (waitSinceBegin(GOT_IP_BIT, timeoutMs) & GOT_IP_BIT) {
+        Serial.printf("[WiFi] Połączono po %lu ms od startu łączenia.\n", millis() - beginTime);
+        return true;
+    }
+    return false;
+}
+
+bool wifiConnectionIsConnected() {
+    return WiFi.status() == WL_CONNECTED;
+}
+
+void wifiConnectionStartPortal(uint16_t timeoutSec) {
+    if (portal != nullptr) return;
+
+    portal = new WiFiManager();
+    portal->setConfigPortalBlocking(false);
+    portal->setConfigPortalTimeout(timeoutSec);
+    portal->setWiFiAutoReconnect(true);
+
+    // Nazwa sieci AP
+    String apName = "Flaura-Wifi-" + String((uint32_t)ESP.getEfuseMac(), HEX);
+    Serial.printf("[WiFi] Portal konfiguracyjny '%s' otwarty (%u s) - sterowanie działa dalej.\n",
+                  apName.c_str(), timeoutSec);
+    portal->startConfigPortal(apName.c_str());
+    lastPortalProcessTime = millis();
+}
+
+void wifiConnectionPortalProcess() {
+    if (portal == nullptr) return;
+    lastPortalProcessTime = millis();
+
+    // process() zwraca true po zapisaniu danych i połączeniu; sam też pilnuje timeoutu
+    bool connected = portal->process();
+    if (!connected && portal->getConfigPortalActive()) return;
+
+    if (connected || wifiConnectionIsConnected()) {
+        Serial.println(F("[WiFi] Portal: sieć skonfigurowana, połączono."));
+    } else {
+        Serial.println(F("[WiFi] Portal zamknięty bez konfiguracji (timeout)."));
+    }
+    delete portal;
+    portal = nullptr;
+}
+
+uint32_t wifiConnectionPortalNextMs() {
+    if (portal == nullptr) return SCHEDULER_IDLE;
+    unsigned long elapsed = millis() - lastPortalProcessTime;
+    return elapsed >= PORTAL_PROCESS_INTERVAL_MS ? 0 : (uint32_t)(PORTAL_PROCESS_INTERVAL_MS - elapsed);
+}
+
+bool wifiConnectionPortalActive() {
+    return portal != nullptr;
+}
@@ -13,16 +13,10 @@
  #include <esp_sleep.h>
  #include <cmath>
  #include <WiFi.h>
- #include <WiFiManager.h>
- #include <HTTPClient.h>
- #include <ArduinoJson.h>
-
- #if __has_include("secrets.h")
- #include "secrets.h"
- #endif
  
  // System modules
  #include "DeviceConfig.h"
+ #include "SensorData.h"
  #include "SoilSensor.h"
  #include "WaterLevelSensor.h"
  #include "PumpControl.h"
@@ -33,58 +27,66 @@
  #include "ButtonManager.h"
  #include "LedManager.h"
  #include "BackendTasks.h"
+ #include "BlynkManager.h"
+ #include "Scheduler.h"
+ #include "SensorBus.h"
+ #include "MeasurementPipeline.h"
+ #include "WiFiConnection.h"
+ #include "TelemetryHistory.h"
+ #include "LinkQuality.h"
+ #include "LocalApi.h"
  #include <Preferences.h>
  #include "test.h"  
  
 
  // Configuration constants
 
- constexpr uint16_t WEBPORTAL_TIMEOUT_SEC = 120;
- constexpr uint8_t WIFI_CONNECTION_TIMEOUT_SEC = 10;
-
- #ifndef FLORA_BACKEND_BASE_URL
- #define FLORA_BACKEND_BASE_URL "http://127.0.0.1:8080"
+ // Actuate-first: decyzja o pompie/alarmie z lokalnej konfiguracji zaraz po pomiarze,
+ // synchronizacja z backendem dopiero potem (zmiany konfiguracji są uzgadniane po niej).
+ // -D FLORA_ACTUATE_FIRST=0 przywraca kolejność: sieć → konfiguracja → pompa.
+ #ifndef FLORA_ACTUATE_FIRST
+ #define FLORA_ACTUATE_FIRST 1
  #endif
 
- #ifndef FLORA_BACKEND_TOKEN
- #define FLORA_BACKEND_TOKEN "replace_me"
+ // Wybudzenia pomiarowe bez radia: timer co FLORA_SENSING_INTERVAL_SEC tylko mierzy i dopisuje pomiar
+ // do historii RTC. WiFi włącza się przy zdarzeniu (alarm, pompa, duża zmiana, zapełniony bufor)
+ // albo o zaplanowanej godzinie pomiaru. 0 = każde wybudzenie łączy się z siecią.
+ #ifndef FLORA_SENSING_INTERVAL_SEC
+ #define FLORA_SENSING_INTERVAL_SEC 3600
  #endif
 
- #ifndef FLORA_BACKEND_DEVICE_ID
- #define FLORA_BACKEND_DEVICE_ID "flora-1"
+ // Okna nasłuchu: w trybie Deep Sleep timer co FLORA_LISTEN_INTERVAL_SEC tylko łączy WiFi i pyta
+ // o komendy (bez czujników) - "Podlej teraz" czeka najwyżej tyle, a nie do pomiaru. 0 = wyłączone.
+ #ifndef FLORA_LISTEN_INTERVAL_SEC
+ #define FLORA_LISTEN_INTERVAL_SEC 0
  #endif
- 
- /**
-  * @struct SensorData
-  * @brief Structure storing data from all sensors
-  */
- struct SensorData {
-     int soilMoisture = -1;
-     int waterLevel = -1;
-     float batteryVoltage = -1.0f;
-     float temperature = NAN;
-     float humidity = NAN;
-     bool dhtOk = false;
-     
-     /**
-      * @brief Checks if data is valid
-      * @return true if basic data is available
-      */
-     bool isValid() const {
-         return soilMoisture >= 0 && waterLevel >= 0 && batteryVoltage > 0;
-     }
- };
+
+ constexpr uint16_t WEBPORTAL_TIMEOUT_SEC = 120;
+ constexpr uint8_t WIFI_CONNECTION_TIMEOUT_SEC = 10;
+
+ constexpr uint32_t BACKEND_SYNC_TIMEOUT_MS = 8000;  // telemetry (3s) + config (2s) + komendy (2s)
+ constexpr uint32_t LISTEN_WINDOW_TIMEOUT_MS = 3000; // Okno nasłuchu: samo zapytanie o komendy (2s)
+ constexpr uint32_t WIFI_CHECK_INTERVAL_MS = 1000;   // Sprawdzanie stanu WiFi w trybie ciągłym
+ constexpr uint32_t DEFAULT_MEASUREMENT_INTERVAL_MS = 60000;
+ constexpr int SIGNIFICANT_SOIL_CHANGE_PERCENT = 5;     // Zmiana wilgotności, która budzi radio
+ constexpr size_t HISTORY_UPLINK_THRESHOLD = TELEMETRY_HISTORY_CAPACITY * 3 / 4;
  
  // Local static variables
  namespace {
-     SensorData g_latestSensorData;
      unsigned long g_lastMeasurementTime = 0;
+     unsigned long g_lastWifiCheckTime = 0;
      bool g_isMeasuring = false;
      bool g_isConnectingWifi = false;
+     bool g_measurementRequested = false;
+
+     // Ostatni pomiar wysłany z włączonym radiem (porównanie dla wybudzeń pomiarowych)
+     RTC_DATA_ATTR int g_uplinkSoilMoisture = -1;
+     RTC_DATA_ATTR int g_uplinkWaterLevel = -1;
  }
 
  // Function declarations
- SensorData performMeasurement();
+ const SensorData& performMeasurement();
+ void onMeasurementDone(const SensorData& data);
  void displayMeasurements(const SensorData& data);
  void print_wakeup_reason();
  void updateLedBasedOnState();
@@ -92,7 +94,16 @@
  void handleMeasurementCycle();
  void setMeasuringStatus(bool isActive);
  void setConnectingWifiStatus(bool isActive);
- bool backendSendTelemetry(const SensorData& data);
+ void queueTelemetry(const SensorData& data);
+ void queueEvent(BackendEvent event);
+ void reportPumpTransition();
+ void registerSensorBusSubscribers();
+ void onAlarmStateChanged();
+ void onSensorDataPump(const SensorData& data, uint32_t version);
+ void onLocalConfigApplied();
+ void registerSchedulerTasks();
+ bool sensingWakeNeedsUplink(const SensorData& data);
+ void runListenWindow();
 
  /**
   * @brief Device configuration at startup
@@ -104,6 +115,7 @@
      //clearPreferencesData("flaura_cfg_1"); // comment in normal mode
      Serial.println(F("\n--- Flora Smart Pot - Main Start ---"));
      print_wakeup_reason();
+     powerManagerInitClock();  // Strefa czasowa + korekta dryftu RTC za czas snu
     
      // I2C initialization
      Wire.begin();
@@ -112,7 +124,25 @@
      // Load configuration
      configSetup();
 
+     // Asocjacja WiFi startuje od razu i trwa w tle równolegle z inicjalizacją i pomiarem.
+     // Wybudzenie pomiarowe nie włącza radia, dopóki pomiar nie pokaże, że jest po co.
+     const PowerWakeKind wakeKind = powerManagerWakeKind();
+     const bool sensingWake = FLORA_SENSING_INTERVAL_SEC > 0 && wakeKind == POWER_WAKE_SENSING;
+     const bool listenWake = FLORA_LISTEN_INTERVAL_SEC > 0 && wakeKind == POWER_WAKE_LISTEN;
+     if (sensingWake) {
+         Serial.println(F("[SETUP] Wybudzenie pomiarowe - WiFi pozostaje wyłączone."));
+     } else {
+         wifiConnectionBegin();
+     }
+
      backendTasksSetup();
+     backendTasksSetListenWindow(listenWake);
+     backendTasksStart();
+
+     // Wybudzenie nasłuchu bez komend kończy się tutaj (Deep Sleep) - przed czujnikami
+     if (listenWake) {
+         runListenWindow();
+     }
 
      testPrintConfig();
 
@@ -124,285 +154,413 @@
      batteryMonitorSetup();
      environmentSensorSetup();
      alarmManagerSetup();
+     schedulerSetup();
      buttonSetup();
+     registerSensorBusSubscribers();
  
      ledManagerBlink(100);  // Sygnalizacja inicjalizacji
  
-     // Pierwszy pomiar po uruchomieniu
+     // Pierwszy pomiar po uruchomieniu (odbiorcy SensorBus: alarm + kolejka telemetry)
      Serial.println(F("\n--- Pierwszy pomiar po starcie ---"));
-     g_latestSensorData = performMeasurement();
- 
-     // Aktualizacja stanu alarmu na podstawie pierwszego pomiaru
-     alarmManagerUpdate(
-         g_latestSensorData.waterLevel, 
-         g_latestSensorData.batteryVoltage, 
-         g_latestSensorData.soilMoisture
-     );
+     const SensorData& firstData = performMeasurement();
  
      if (alarmManagerIsAlarmActive()) {
          Serial.println(F("[SETUP] Wykryto aktywny alarm!"));
      }
  
-     // Display measurement results
-     displayMeasurements(g_latestSensorData);
+ #if FLORA_ACTUATE_FIRST
+     // Sucha roślina nie czeka na sieć - decyzja z konfiguracji zapisanej we Flash
+     Serial.println(F("[SETUP] Actuate-first: decyzja o pompie przed synchronizacją."));
+     pumpControlActivateIfNeeded(firstData.soilMoisture, firstData.waterLevel);
+     reportPumpTransition();
+ #endif
+
+     if (sensingWake) {
+         if (!sensingWakeNeedsUplink(firstData)) {
+             // Pomiar czeka w pamięci RTC na najbliższe wybudzenie z siecią
+             backendTasksStashPendingTelemetry();
+             ledManagerTurnOff();
+             powerManagerGoToDeepSleep(FLORA_SENSING_INTERVAL_SEC, FLORA_LISTEN_INTERVAL_SEC);
+         }
+         wifiConnectionBegin();
+     }
  
-     // Konfiguracja sieci WiFi
+     // Konfiguracja sieci WiFi (łączenie trwa już od configSetup())
      bool wifiConnected = setupWiFiConnection();
      
      // Operations after WiFi connection attempt
      if (wifiConnected) {
          Serial.println(F("Połączenie WiFi aktywne (Blynk wyłączony w main)."));
          
-         // 1. Najpierw wysyłamy obecny stan czujników
-         backendSendTelemetry(g_latestSensorData);
-         
-         // 2. NOWOŚĆ: Pobieramy ustawienia z apki (Tryb ciągły, czas pompy itd.)!
-         // To nadpisze stare ustawienia w pamięci Flash.
-         fetchAndApplyConfiguration(); 
+         // 1. Obecny stan czujników jest już w kolejce telemetry (odbiorca SensorBus)
+         // 2. Czekamy aż zadanie sieciowe wyśle dane i pobierze ustawienia z apki
+         // (Tryb ciągły, czas pompy itd.) oraz ręczne komendy (np. "Podlej teraz").
+         backendTasksWaitForSync(BACKEND_SYNC_TIMEOUT_MS);
+         g_uplinkSoilMoisture = firstData.soilMoisture;
+         g_uplinkWaterLevel = firstData.waterLevel;
          
      } else {
-         Serial.println(F("Pomijam wysyłkę pierwszych danych - brak połączenia WiFi."));         
+         Serial.println(F("Brak połączenia WiFi - pomiar trafi do historii w pamięci RTC."));
      }
      
      g_lastMeasurementTime = millis();
 
-     // 3. Sprawdzamy ręczne komendy (np. "Podlej teraz")
-     fetchAndExecuteCommands(g_latestSensorData.waterLevel);
+     // 3. Stosujemy pobraną konfigurację (nadpisze stare ustawienia we Flash) i wykonujemy komendy
+     const bool backendApplied = backendTasksProcess(firstData.waterLevel);
+     if (backendApplied) {
+         alarmManagerReevaluate();  // Progi alarmów mogły się zmienić
+     }
 
-     // Kontrola pompy na podstawie pierwszego pomiaru
-     pumpControlActivateIfNeeded(g_latestSensorData.soilMoisture, g_latestSensorData.waterLevel);
+ #if FLORA_ACTUATE_FIRST
+     // Uzgodnienie: nowy próg wilgotności mógł uznać ten sam pomiar za "sucho".
+     // Trwające podlewanie kończy się zgodnie z decyzją podjętą przed synchronizacją.
+     if (backendApplied && !pumpControlIsRunning()) {
+         pumpControlActivateIfNeeded(firstData.soilMoisture, firstData.waterLevel);
+     }
+ #else
+     // Kontrola pompy na podstawie pierwszego pomiaru (już z pobraną konfiguracją)
+     pumpControlActivateIfNeeded(firstData.soilMoisture, firstData.waterLevel);
+ #endif
+     reportPumpTransition();
  
      // Decision about operation mode (active/sleep)
      // UWAGA: configIsContinuousMode() teraz zwróci świeżutką wartość, którą pobraliśmy 20 linijek wyżej!
      const bool shouldSleep = !configIsContinuousMode() && 
                              !alarmManagerIsAlarmActive() && 
-                             !pumpControlIsRunning();
+                             !pumpControlIsRunning() &&
+                             !wifiConnectionPortalActive();
                              
      if (shouldSleep) {
          ledManagerTurnOff();
+         backendTasksStashPendingTelemetry();  // Niewysłany pomiar przetrwa sen w pamięci RTC
          Serial.println(F("Konfiguruję wybudzanie i przechodzę w Deep Sleep..."));
-         powerManagerGoToDeepSleep();
+         powerManagerGoToDeepSleep(FLORA_SENSING_INTERVAL_SEC, FLORA_LISTEN_INTERVAL_SEC);
      } else {
          if (pumpControlIsRunning()) {
              Serial.println(F("Pompa pracuje - pozostaję w trybie aktywnym."));
+         } else if (wifiConnectionPortalActive()) {
+             Serial.println(F("Portal WiFi otwarty - pozostaję w trybie aktywnym."));
          } else {
              Serial.println(F("Tryb ciągły aktywny. Dalsza praca w loop()."));
          }
+         backendTasksStartCommandChannel();
+         registerSchedulerTasks();
      }
  }
 
  
  /**
   * @brief Main program loop
+  *
+  * Zamiast odpytywać wszystkie moduły co 10 ms, pętla śpi do najbliższego terminu
+  * zgłoszonego przez moduły (LED, pompa, alarm, pomiar) albo do zdarzenia
+  * (przycisk, dane z zadania sieciowego).
   */
  void loop() {
-     // Update basic components
-     ledManagerUpdate();
+     schedulerRun();
+ }
+ 
+ // =============================================================
+ //  Zadania schedulera (wykonywane w loop())
+ // =============================================================
+ 
+ uint32_t measurementIntervalMs() {
+     uint32_t interval = configGetBlynkSendIntervalSec() * 1000;
+     return interval == 0 ? DEFAULT_MEASUREMENT_INTERVAL_MS : interval;  // Default interval 60s
+ }
+ 
+ uint32_t remainingMs(unsigned long since, uint32_t interval) {
+     unsigned long elapsed = millis() - since;
+     return elapsed >= interval ? 0 : (uint32_t)(interval - elapsed);
+ }
+ 
+ void ledTaskRun() { ledManagerUpdate(); }
+ 
+ void pumpTaskRun() {
      pumpControlUpdate();
-     
-     // Network handling
-     if (WiFi.status() == WL_CONNECTED) {
-         // WiFi connected; cloud handling moved out of main (Blynk disabled here)
-         fetchAndApplyConfiguration();
-         fetchAndExecuteCommands(g_latestSensorData.waterLevel);
-     } else if (!alarmManagerIsAlarmActive() && !pumpControlIsRunning()) {
+     reportPumpTransition();
+ }
+ 
+ // Network handling - całe I/O backendu działa w osobnym zadaniu, tu tylko odbieramy jego wyniki
+ void networkTaskRun() {
+     g_lastWifiCheckTime = millis();
+ 
+     // Kolejki opróżniamy także bez WiFi - inaczej networkTaskNext() zwraca 0 w nieskończoność
+     if (backendTasksProcess(sensorBusLatest().waterLevel) && alarmManagerReevaluate()) {
+         // Progi alarmów się zmieniły - ten sam pomiar, nowy stan alarmu (zdarzenie w onAlarmStateChanged)
+         onAlarmStateChanged();
+     }
+     reportPumpTransition();  // Komenda "podlej" z aplikacji
+ 
+     if (WiFi.status() != WL_CONNECTED && configIsContinuousMode() && !wifiConnectionPortalActive() &&
+         !alarmManagerIsAlarmActive() && !pumpControlIsRunning()) {
+         // Portal konfiguracji trzyma urządzenie w stanie aktywnym - decyzja o uśpieniu po jego zamknięciu
          Serial.println(F("Brak aktywnego alarmu oraz połączenia z siecią - włączam tryb uśpienia"));
          ledManagerTurnOff();
          configSetContinuousMode(false);
      }
+ }
  
-     // Handle measurement cycles in continuous mode
-     if (configIsContinuousMode()) {
-         uint32_t interval = configGetBlynkSendIntervalSec() * 1000;
-         if (interval == 0) interval = 60000;  // Default interval 60s
+ uint32_t networkTaskNext() {
+     if (backendTasksHasPending()) return 0;
+     return remainingMs(g_lastWifiCheckTime, WIFI_CHECK_INTERVAL_MS);
+ }
  
-         // Check if it's time for measurement
-         if ((millis() - g_lastMeasurementTime > interval) || buttonWasPressed()) {
-             handleMeasurementCycle();
-         }
-     } else {
-         // Handle Deep Sleep mode
-         if (!pumpControlIsRunning() && !alarmManagerIsAlarmActive()) {
-             Serial.println(F("[Loop] Pompa zakończyła pracę w trybie Deep Sleep, przechodzę do uśpienia..."));
-             ledManagerTurnOff();
-             powerManagerGoToDeepSleep();
-         }
+ void buttonTaskRun() {
+     if (buttonWasPressed()) {
+         g_measurementRequested = true;
      }
-        
-     // Aktualizacja stanu alarmu
-     bool alarmStateChanged = alarmManagerUpdate(
-         g_latestSensorData.waterLevel, 
-         g_latestSensorData.batteryVoltage, 
-         g_latestSensorData.soilMoisture
-     );
-     
-     // Log alarm state change (cloud integration currently disabled in main)
-     if (alarmStateChanged) {
-         Serial.printf("[Loop] Zmiana stanu alarmu: %s\n", alarmManagerIsAlarmActive() ? "AKTYWNY" : "NIEAKTYWNY");
-         backendSendTelemetry(g_latestSensorData);
+ }
+ 
+ // Handle measurement cycles in continuous mode
+ void measurementTaskRun() {
+     if (!configIsContinuousMode() || measurementPipelineIsRunning()) return;
+     if (!g_measurementRequested && remainingMs(g_lastMeasurementTime, measurementIntervalMs()) > 0) return;
+ 
+     g_measurementRequested = false;
+     handleMeasurementCycle();
+ }
+ 
+ uint32_t measurementTaskNext() {
+     if (!configIsContinuousMode() || measurementPipelineIsRunning()) return SCHEDULER_IDLE;
+     if (g_measurementRequested) return 0;
+     return remainingMs(g_lastMeasurementTime, measurementIntervalMs());
+ }
+ 
+ // Handle Deep Sleep mode
+ bool canGoToSleep() {
+     return !configIsContinuousMode() && !pumpControlIsRunning() && !alarmManagerIsAlarmActive() &&
+            !measurementPipelineIsRunning() && !wifiConnectionPortalActive();
+ }
+ 
+ void powerTaskRun() {
+     if (!canGoToSleep()) return;
+     Serial.println(F("[Loop] Pompa zakończyła pracę w trybie Deep Sleep, przechodzę do uśpienia..."));
+     ledManagerTurnOff();
+     powerManagerGoToDeepSleep(FLORA_SENSING_INTERVAL_SEC, FLORA_LISTEN_INTERVAL_SEC);
+ }
+ 
+ uint32_t powerTaskNext() {
+     return canGoToSleep() ? 0 : SCHEDULER_IDLE;
+ }
+ 
+ // Portal konfiguracyjny WiFi (nieblokujący) - obsługiwany tylko gdy jest otwarty
+ void portalTaskRun() {
+     if (!wifiConnectionPortalActive()) return;
+     wifiConnectionPortalProcess();
+     if (wifiConnectionPortalActive()) return;
+
+     // Portal właśnie się zamknął
+     setConnectingWifiStatus(false);
+     if (wifiConnectionIsConnected()) {
+         Serial.print(F("Połączono z WiFi przez portal. Adres IP: "));
+         Serial.println(WiFi.localIP());
+         powerManagerBeginTimeSync();  // NTP w tle - nie blokujemy pętli
+     } else {
+         Serial.println(F("Portal zamknięty - pozostaję w trybie OFFLINE."));
      }
-     
+ }
+ 
+ // Sekwencja sygnałów buzzera - stan alarmu liczy odbiorca SensorBus (raz na pomiar)
+ void alarmTaskRun() { alarmManagerUpdate(); }
+ 
+ /**
+  * @brief Rejestruje zadania pętli głównej w schedulerze (kolejność = kolejność wykonania)
+  */
+ void registerSchedulerTasks() {
+     g_lastWifiCheckTime = millis();
+ 
+     schedulerAdd("led",     ledTaskRun,         ledManagerNextUpdateMs);
+     schedulerAdd("pump",    pumpTaskRun,        pumpControlNextUpdateMs);
+     schedulerAdd("network", networkTaskRun,     networkTaskNext);
+     schedulerAdd("portal",  portalTaskRun,      wifiConnectionPortalNextMs);
+     schedulerAdd("button",  buttonTaskRun,      buttonNextUpdateMs);
+     schedulerAdd("sensors", measurementPipelineUpdate, measurementPipelineNextUpdateMs);
+     schedulerAdd("measure", measurementTaskRun, measurementTaskNext);
+     schedulerAdd("power",   powerTaskRun,       powerTaskNext);
+     schedulerAdd("alarm",   alarmTaskRun,       alarmManagerNextUpdateMs);
+     schedulerAdd("lan",     localApiProcess,    localApiNextMs);
+
+     localApiSetup(onLocalConfigApplied);
+
+     // W setup() pompa jest sterowana ręcznie dopiero po synchronizacji konfiguracji,
+     // w trybie ciągłym reaguje na każdy nowy pomiar
+     sensorBusSubscribe("pump", onSensorDataPump);
+ }
+ 
+ // =============================================================
+ //  Odbiorcy SensorBus (wywoływani raz na każdy nowy pomiar)
+ // =============================================================
+ 
+ void onAlarmStateChanged() {
+     Serial.printf("[Loop] Zmiana stanu alarmu: %s\n", alarmManagerIsAlarmActive() ? "AKTYWNY" : "NIEAKTYWNY");
      updateLedBasedOnState();
-     delay(10);  // Small delay for loop stability
+     queueEvent(BACKEND_EVENT_ALARM);
  }
  
+ // Konfiguracja z lokalnego API - jak po komendach z backendu w networkTaskRun()
+ void onLocalConfigApplied() {
+     if (alarmManagerReevaluate()) {
+         onAlarmStateChanged();
+     }
+ }
+ 
+ void onSensorDataAlarm(const SensorData& data, uint32_t version) {
+     (void)version;
+     if (alarmManagerEvaluate(data.waterLevel, data.batteryVoltage, data.soilMoisture)) {
+         onAlarmStateChanged();
+     }
+ }
+ 
+ void onSensorDataPump(const SensorData& data, uint32_t version) {
+     (void)version;
+     pumpControlActivateIfNeeded(data.soilMoisture, data.waterLevel);
+     reportPumpTransition();
+ }
+ 
+ void onSensorDataTelemetry(const SensorData& data, uint32_t version) {
+     (void)version;
+     queueTelemetry(data);
+ }
+ 
+ void onSensorDataBlynk(const SensorData& data, uint32_t version) {
+     (void)version;
+     if (!blynkIsConnected()) return;  // Blynk wyłączony w main - nie spamujemy logu
+     blynkSendSensorData(data.soilMoisture, data.waterLevel, data.batteryVoltage,
+                         data.temperature, data.humidity,
+                         pumpControlIsRunning(), alarmManagerIsAlarmActive());
+ }
+ 
+ /**
+  * @brief Rejestruje odbiorców pomiarów (kolejność = kolejność wywołania; alarm pierwszy,
+  * żeby telemetry zawierała już aktualny stan alarmu)
+  */
+ void registerSensorBusSubscribers() {
+     sensorBusSubscribe("alarm",     onSensorDataAlarm);
+     sensorBusSubscribe("telemetry", onSensorDataTelemetry);
+     sensorBusSubscribe("blynk",     onSensorDataBlynk);
+ }
+ 
+ /**
+  * @brief Wybudzenie nasłuchu: WiFi i jedno zapytanie o komendy, bez czujników i telemetrii.
+  * Bez komend wraca do Deep Sleep. Z komendą wraca do setup(), który robi pełny cykl -
+  * pompa ruszy dopiero po pomiarze poziomu wody, jak przy zwykłym wybudzeniu.
+  */
+ void runListenWindow() {
+     Serial.println(F("[SETUP] Wybudzenie nasłuchu - sprawdzam tylko komendy."));
+     if (wifiConnectionAwait(WIFI_CONNECTION_TIMEOUT_SEC * 1000UL)) {
+         backendTasksWaitForSync(LISTEN_WINDOW_TIMEOUT_MS);
+     } else {
+         Serial.println(F("[SETUP] Brak WiFi - komendy poczekają na kolejne wybudzenie."));
+     }
+
+     if (!backendTasksHasPending()) {
+         Serial.println(F("[SETUP] Brak komend - wracam do Deep Sleep."));
+         powerManagerGoToDeepSleep(FLORA_SENSING_INTERVAL_SEC, FLORA_LISTEN_INTERVAL_SEC);
+     }
+
+     Serial.println(F("[SETUP] Odebrano komendę - pełny cykl z pomiarem."));
+     backendTasksSetListenWindow(false);
+ }
+
  /**
-  * @brief Konfiguracja i próba połączenia z siecią WiFi
+  * @brief Dokończenie połączenia WiFi rozpoczętego w wifiConnectionBegin().
+  * WiFiManager (portal) uruchamiamy tylko gdy zapisana sieć zawiedzie po resecie/Power-On.
   * @return true jeśli połączenie udane
   */
  bool setupWiFiConnection() {
-     bool connectSuccess = false;
      esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
-  
-     WiFi.mode(WIFI_STA);
-     WiFiManager wm;
-     wm.setConnectTimeout(WIFI_CONNECTION_TIMEOUT_SEC);
-     
-     // Konfiguracja portalu na podstawie przyczyny wybudzenia
-     if (wakeup_reason == ESP_SLEEP_WAKEUP_UNDEFINED) {
-         // Reset lub Power-On
-         Serial.println(F("[WiFi] Wykryto Reset/Power-On. Ustawiam timeout portalu."));
-         wm.setConfigPortalTimeout(WEBPORTAL_TIMEOUT_SEC);
-     } else {
-         // Wybudzenie z Deep Sleep
-         Serial.println(F("[WiFi] Wykryto wybudzenie z Deep Sleep. Wyłączam portal konfiguracyjny."));
-         wm.setConfigPortalTimeout(0);
-         wm.setEnableConfigPortal(false);
-     }
-  
-     wm.setWiFiAutoReconnect(true);
-  
-     // Nazwa sieci AP
-     String apName = "Flaura-Wifi-" + String((uint32_t)ESP.getEfuseMac(), HEX);
-  
-     Serial.println(F("Próba auto-połączenia z zapisaną siecią WiFi..."));
+ 
      setConnectingWifiStatus(true);
-     
-     if (wm.autoConnect(apName.c_str())) {
-         Serial.println(F("\nPołączono z WiFi!"));
-         Serial.print(F("Adres IP: "));
+     if (wifiConnectionAwait(WIFI_CONNECTION_TIMEOUT_SEC * 1000UL)) {
+         Serial.print(F("Połączono z WiFi (w tle). Adres IP: "));
          Serial.println(WiFi.localIP());
-         connectSuccess = true;
-         
-         // Synchronizacja czasu po udanym połączeniu WiFi
-         powerManagerSyncTime();
-     } else {
-         Serial.println(F("\nOSTRZEŻENIE: Nie udało się połączyć z WiFi lub skonfigurować."));
+         setConnectingWifiStatus(false);
+ 
+         // Zegar przetrwał sen, a odpowiedzi backendu (Date) go korygują - NTP w tle i tylko co
+         // kilkanaście wybudzeń, gdy zegar nie jest ustawiony albo serwer wykazał dużą rozbieżność
+         if (powerManagerTimeSyncDue()) {
+             powerManagerBeginTimeSync();
+         }
+         return true;
+     }
+ 
+     if (wakeup_reason != ESP_SLEEP_WAKEUP_UNDEFINED) {
+         // Po Deep Sleep portal i tak jest wyłączony - WiFiManager tylko powtórzyłby to samo łączenie
+         Serial.println(F("\nOSTRZEŻENIE: Nie udało się połączyć z zapisaną siecią WiFi."));
          Serial.println(F("Przechodzę w tryb OFFLINE."));
-         connectSuccess = false;
+         setConnectingWifiStatus(false);
+         return false;
      }
-     
-     setConnectingWifiStatus(false);
-     return connectSuccess;
+  
+     // Reset lub Power-On: zapisana sieć (jeśli jest) zawiodła - portal w tle, setup() idzie dalej
+     // (pomiar, alarm i pompa działają; łączenie kończy zadanie "portal" w schedulerze)
+     Serial.println(F("Brak połączenia - otwieram portal konfiguracyjny, na razie tryb OFFLINE."));
+     wifiConnectionStartPortal(WEBPORTAL_TIMEOUT_SEC);
+     return false;
  }
  
  /**
-  * @brief Wykonanie pełnego cyklu pomiarowego
+  * @brief Rozpoczyna cykl pomiarowy (nieblokujący - kanały prowadzi zadanie "sensors",
+  * wynik trafia do onMeasurementDone())
   */
 void handleMeasurementCycle() {
-     // Read sensors
-     g_latestSensorData = performMeasurement();
+     setMeasuringStatus(true);
+     measurementPipelineStart(onMeasurementDone);
+}
+
+/**
+ * @brief Zakończenie pomiaru - publikacja w SensorBus (alarm, pompa i telemetry reagują
+ * jako odbiorcy)
+ */
+void onMeasurementDone(const SensorData& data) {
+     setMeasuringStatus(false);
+     Serial.printf("Odczyt sensorów zakończony (pomiar #%u).\n", sensorBusPublish(data));
      
      // Display results
-     displayMeasurements(g_latestSensorData);
- 
-     backendSendTelemetry(g_latestSensorData);
+     displayMeasurements(data);
      
      Serial.print(F("Stan alarmu: "));
      Serial.println(alarmManagerIsAlarmActive());
  
-     // Kontrola pompy
-     pumpControlActivateIfNeeded(g_latestSensorData.soilMoisture, g_latestSensorData.waterLevel);
- 
      // Aktualizacja czasu ostatniego pomiaru
      g_lastMeasurementTime = millis();
 }
 
 /**
- * @brief Wysyła telemetry snapshot do backendu mobile_backend
+ * @brief Przekazuje snapshot do zadania sieciowego (nie blokuje)
  */
-bool backendSendTelemetry(const SensorData& data) {
-    if (WiFi.status() != WL_CONNECTED) {
-        Serial.println(F("[Backend] Brak WiFi - pomijam telemetry push."));
-        return false;
-    }
-
-    HTTPClient http;
-    const String url = String(FLORA_BACKEND_BASE_URL) + "/api/flora/" + FLORA_BACKEND_DEVICE_ID + "/telemetry";
-    http.begin(url);
-    http.setTimeout(3000);
-    http.addHeader("Content-Type", "application/json");
-    http.addHeader("Authorization", String("Bearer ") + FLORA_BACKEND_TOKEN);
-
-    const bool dhtValid = !isnan(data.temperature) && !isnan(data.humidity);
-    const float temp = dhtValid ? data.temperature : 0.0f;
-    const float humid = dhtValid ? data.humidity : 0.0f;
-
-    char payload[512];
-    snprintf(
-        payload,
-        sizeof(payload),
-        "{\"snapshot\":{\"soilMoisturePercent\":%d,\"waterLevel\":%d,\"batteryVoltage\":%.2f,\"temperature\":%.2f,"
-        "\"humidity\":%.2f,\"pumpRunning\":%s,\"alarmActive\":%s,\"updatedAt\":\"\"}}",
-        data.soilMoisture,
-        data.waterLevel,
-        data.batteryVoltage,
-        temp,
-        humid,
-        pumpControlIsRunning() ? "true" : "false",
-        alarmManagerIsAlarmActive() ? "true" : "false");
+void queueTelemetry(const SensorData& data) {
+    backendQueueTelemetry(data, pumpControlIsRunning(), alarmManagerIsAlarmActive());
+}
 
-    const int httpCode = http.POST((uint8_t*)payload, strlen(payload));
-    if (httpCode > 0) {
-        String response = http.getString();
-        Serial.printf("[Backend] Telemetry HTTP %d\n", httpCode);
-        if (httpCode >= 200 && httpCode < 300) {
-            http.end();
-            return true;
-        }
-        Serial.printf("[Backend] Odpowiedź: %s\n", response.c_str());
-    } else {
-        Serial.printf("[Backend] Błąd POST: %s\n", http.errorToString(httpCode).c_str());
-    }
+/**
+ * @brief Zdarzenie (alarm, pompa) z najnowszym pomiarem - pas priorytetowy zadania sieciowego
+ */
+void queueEvent(BackendEvent event) {
+    backendQueueEvent(event, sensorBusLatest(), pumpControlIsRunning(), alarmManagerIsAlarmActive());
+}
 
-    http.end();
-    return false;
+/**
+ * @brief Zgłasza start/stop pompy (wywoływane po każdym miejscu, które może zmienić jej stan)
+ */
+void reportPumpTransition() {
+    static bool wasRunning = false;
+    const bool running = pumpControlIsRunning();
+    if (running == wasRunning) return;
+    wasRunning = running;
+    queueEvent(running ? BACKEND_EVENT_PUMP_START : BACKEND_EVENT_PUMP_STOP);
 }
  
  /**
-  * @brief Odczyt wszystkich sensorów
-  * @return Struktura z danymi pomiarowymi
+  * @brief Pomiar blokujący (setup(), przed startem schedulera). Kanały i tak pracują
+  * równolegle, więc czas ≈ najdłuższa stabilizacja (DHT), a nie suma wszystkich.
+  * @return Opublikowany pomiar (sensorBusLatest())
   */
- SensorData performMeasurement() {
-     setMeasuringStatus(true);
- 
-     SensorData data;
- 
-     // Soil moisture measurement
-     data.soilMoisture = soilSensorReadPercent();
-     
-     // Pomiar poziomu wody
-     data.waterLevel = waterLevelSensorReadLevel();
-     
-     // Battery voltage measurement
-     data.batteryVoltage = batteryMonitorReadVoltage();
- 
-     // Air temperature and humidity measurement
-     float tempDHT, humDHT;
-     data.dhtOk = environmentSensorRead(tempDHT, humDHT);
-     
-     if (data.dhtOk) {
-         data.temperature = tempDHT;
-         data.humidity = humDHT;
-     } else {
-         data.temperature = NAN;
-         data.humidity = NAN;
-     }
- 
-     setMeasuringStatus(false);
-     Serial.println(F("Odczyt sensorów zakończony."));
-     
-     return data;
+ const SensorData& performMeasurement() {
+     handleMeasurementCycle();
+     measurementPipelineAwait();
+     return sensorBusLatest();
  }
  
  /**
@@ -440,6 +598,36 @@ bool backendSendTelemetry(const SensorData& data) {
      Serial.println(F("-----------------------"));
  }
  
+ /**
+  * @brief Czy wybudzenie pomiarowe musi włączyć radio? (wywoływane po decyzji o pompie)
+  * @return true przy alarmie, podlewaniu, suchej glebie, dużej zmianie od ostatniej wysyłki
+  *         albo prawie pełnej historii w pamięci RTC
+  */
+ bool sensingWakeNeedsUplink(const SensorData& data) {
+     const char* reason = nullptr;
+     if (alarmManagerIsAlarmActive()) {
+         reason = "alarm";
+     } else if (pumpControlIsRunning() ||
+                (data.soilMoisture >= 0 && data.soilMoisture < configGetSoilThresholdPercent())) {
+         reason = "podlewanie";
+     } else if (g_uplinkSoilMoisture < 0 ||
+                abs(data.soilMoisture - g_uplinkSoilMoisture) >= SIGNIFICANT_SOIL_CHANGE_PERCENT ||
+                data.waterLevel != g_uplinkWaterLevel) {
+         reason = "istotna zmiana odczytów";
+     } else if (telemetryHistoryCount() + 1 >= HISTORY_UPLINK_THRESHOLD) {
+         reason = "historia w RTC prawie pełna";
+     } else if (linkQualityPendingDeferrals() > 0) {
+         reason = "ponowienie wysyłki odłożonej przez słabe łącze";
+     }
+
+     if (reason == nullptr) {
+         Serial.println(F("[SETUP] Bez zdarzeń - pomiar zostaje w historii RTC, wracam do snu."));
+         return false;
+     }
+     Serial.printf("[SETUP] Wybudzenie pomiarowe: %s - włączam WiFi.\n", reason);
+     return true;
+ }
+
  /**
   * @brief Wyświetla przyczynę uruchomienia ESP
   */
@@ -15,6 +15,7 @@
 
 #include "test.h"
 #include "DeviceConfig.h"
+#include "Scheduler.h"
 #include <Arduino.h>
 #include <cmath>
 
@@ -82,6 +83,16 @@ int soilSensorReadPercent() {
     Serial.printf("[TEST] soilSensorReadPercent() → %d %%\n", TEST_SOIL_MOISTURE);
     return TEST_SOIL_MOISTURE;
 }
+void soilSensorBeginRead() {}
+bool soilSensorPoll() {
+    return true;
+}
+uint32_t soilSensorNextPollMs() {
+    return 0;
+}
+int soilSensorResult() {
+    return soilSensorReadPercent();
+}
 
 // --- WaterLevelSensor ---
 void waterLevelSensorSetup() {
@@ -91,6 +102,16 @@ int waterLevelSensorReadLevel() {
     Serial.printf("[TEST] waterLevelSensorReadLevel() → %d\n", TEST_WATER_LEVEL);
     return TEST_WATER_LEVEL;
 }
+void waterLevelSensorBeginRead() {}
+bool waterLevelSensorPoll() {
+    return true;
+}
+uint32_t waterLevelSensorNextPollMs() {
+    return 0;
+}
+int waterLevelSensorResult() {
+    return waterLevelSensorReadLevel();
+}
 
 // --- BatteryMonitor ---
 void batteryMonitorSetup() {
@@ -129,6 +150,16 @@ bool environmentSensorRead(float &temperature, float &humidity) {
                   temperature, humidity);
     return true;
 }
+void environmentSensorBeginRead() {}
+bool environmentSensorPoll() {
+    return true;
+}
+uint32_t environmentSensorNextPollMs() {
+    return 0;
+}
+bool environmentSensorResult(float &temperature, float &humidity) {
+    return environmentSensorRead(temperature, humidity);
+}
 
 // --- PumpControl ---
 void pumpControlSetup() {
@@ -138,6 +169,9 @@ void pumpControlSetup() {
     digitalWrite(configGetPumpPin(), LOW);   // pompa wyłączona na start
 }
 void pumpControlUpdate() {}
+uint32_t pumpControlNextUpdateMs() {
+    return SCHEDULER_IDLE;
+}
 bool pumpControlIsRunning() {
     return TEST_PUMP_RUNNING;
 }